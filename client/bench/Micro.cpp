@@ -0,0 +1,313 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+
+#include "Frame.h"
+#include "Event.h"
+#include "Parser.h"
+
+// Microbenchmarks of the client's hot paths. Every benchmark reports the
+// median time per operation over several runs, and the heap bytes and
+// allocations per operation.
+//
+//   MicroBench [--filter text] [--save file] [--compare file] [--threshold %]
+//
+// --save writes the results as a baseline; --compare flags every benchmark
+// that got slower than the baseline by more than the threshold (default 10%)
+// or allocates more than it did, and exits with 1 if any did.
+
+using Clock = std::chrono::steady_clock;
+
+static size_t sAllocations = 0;
+static size_t sBytes = 0;
+
+void* operator new(size_t size)
+{
+    ++sAllocations;
+    sBytes += size;
+
+    void* p = std::malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// results are folded in here so the compiler cannot drop the work
+static volatile size_t sSink = 0;
+
+static const int RUNS = 7;
+static const double MIN_RUN_SECONDS = 0.05;
+
+struct Result
+{
+    std::string name;
+    double nsPerOp;
+    double bytesPerOp;
+    double allocsPerOp;
+};
+
+struct Benchmark
+{
+    std::string name;
+    std::function<void()> op;
+};
+
+static double timeBatch(const std::function<void()>& op, size_t iterations)
+{
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) op();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static Result measure(const Benchmark& benchmark)
+{
+    // warm up and size the batch so each run takes at least MIN_RUN_SECONDS
+    size_t iterations = 1;
+    while (timeBatch(benchmark.op, iterations) < MIN_RUN_SECONDS)
+        iterations *= 2;
+
+    std::vector<double> nsPerOp;
+
+    for (int run = 0; run < RUNS; ++run)
+        nsPerOp.push_back(timeBatch(benchmark.op, iterations) * 1e9 / iterations);
+
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+
+    sAllocations = 0;
+    sBytes = 0;
+    timeBatch(benchmark.op, iterations);
+
+    return {
+        benchmark.name,
+        nsPerOp[RUNS / 2],
+        static_cast<double>(sBytes) / iterations,
+        static_cast<double>(sAllocations) / iterations
+    };
+}
+
+static std::string eventBody(int i)
+{
+    return "user:bob\n"
+           "city:Liberty City\n"
+           "event name:Incident " + std::to_string(i) + "\n"
+           "date time:" + std::to_string(1735000000 + i * 37) + "\n"
+           "general information:\n"
+           "\tactive:" + (i % 2 ? "true" : "false") + "\n"
+           "\tforces_arrival_at_scene:" + (i % 3 ? "true" : "false") + "\n"
+           "description:" + std::string(256, 'x');
+}
+
+static std::string messageFrame()
+{
+    return "MESSAGE\n"
+           "subscription:1\n"
+           "message-id:42\n"
+           "destination:/police\n"
+           "\n" + eventBody(0);
+}
+
+static std::vector<Benchmark> benchmarks(const std::string& eventsFile, const std::string& summaryFile)
+{
+    std::vector<Benchmark> list;
+
+    const std::string raw = messageFrame();
+    const std::string body = eventBody(0);
+
+    Event event(body);
+    event.setChannelName("police");
+    const Frame send = Frame::Send(event, 17);
+
+    std::vector<Event> reports;
+    for (int i = 0; i < 100; ++i) {
+        reports.emplace_back(eventBody((i * 7919) % 100)); // out of order, like a real channel
+        reports.back().setChannelName("police");
+    }
+
+    list.push_back({"Frame::parseFrame", [raw]() {
+        sSink += Frame::parseFrame(raw).body().length();
+    }});
+
+    list.push_back({"Frame::raw", [send]() {
+        sSink += send.raw().length();
+    }});
+
+    list.push_back({"Frame::Send", [event]() {
+        sSink += Frame::Send(event).body().length();
+    }});
+
+    list.push_back({"Event(frame_body)", [body]() {
+        sSink += Event(body).get_description().length();
+    }});
+
+    list.push_back({"Event::toString", [event]() {
+        sSink += event.toString().length();
+    }});
+
+    list.push_back({"Event::fromJsonFile", [eventsFile]() {
+        sSink += Event::fromJsonFile(eventsFile).size();
+    }});
+
+    list.push_back({"Parser::writeSummary/100", [reports, summaryFile]() {
+        Parser::writeSummary(summaryFile, reports);
+        sSink += 1;
+    }});
+
+    list.push_back({"epochToString", []() {
+        sSink += Parser::epochToString(1735000000).length();
+    }});
+
+    return list;
+}
+
+static std::map<std::string, Result> loadBaseline(const std::string& fileName)
+{
+    std::ifstream f(fileName);
+    std::map<std::string, Result> baseline;
+    std::string line;
+
+    if (!f)
+        throw std::runtime_error("Cannot read baseline '" + fileName + '\'');
+
+    while (std::getline(f, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream fields(line);
+        Result result;
+
+        if (fields >> result.name >> result.nsPerOp >> result.bytesPerOp >> result.allocsPerOp)
+            baseline[result.name] = result;
+    }
+
+    return baseline;
+}
+
+static void saveBaseline(const std::string& fileName, const std::vector<Result>& results)
+{
+    std::ofstream f(fileName);
+
+    if (!f)
+        throw std::runtime_error("Cannot write baseline '" + fileName + '\'');
+
+    f << "# name ns/op bytes/op allocs/op\n";
+
+    for (const Result& result : results)
+        f << result.name << ' ' << result.nsPerOp << ' ' << result.bytesPerOp << ' ' << result.allocsPerOp << '\n';
+}
+
+static void usage()
+{
+    std::cerr << "Usage: MicroBench [--filter text] [--save file] [--compare file] [--threshold %]\n"
+                 "                  [--events file.json]\n";
+}
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    std::string saveFile;
+    std::string compareFile;
+    std::string eventsFile = "data/events1.json";
+    double threshold = 10;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+
+        const char* value = argv[++i];
+
+        if (arg == "--filter") filter = value;
+        else if (arg == "--save") saveFile = value;
+        else if (arg == "--compare") compareFile = value;
+        else if (arg == "--threshold") threshold = std::atof(value);
+        else if (arg == "--events") eventsFile = value;
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    try {
+        std::map<std::string, Result> baseline;
+        if (!compareFile.empty()) baseline = loadBaseline(compareFile);
+
+        std::string summaryFile = std::string(P_tmpdir) + "/MicroBench.summary.txt";
+        std::vector<Result> results;
+        size_t regressions = 0;
+
+        std::cout << std::left << std::setw(28) << "benchmark" << std::right
+                  << std::setw(14) << "ns/op" << std::setw(12) << "B/op" << std::setw(12) << "allocs/op";
+        if (!baseline.empty()) std::cout << std::setw(12) << "vs base";
+        std::cout << '\n';
+
+        for (const Benchmark& benchmark : benchmarks(eventsFile, summaryFile)) {
+            if (benchmark.name.find(filter) == std::string::npos)
+                continue;
+
+            Result result = measure(benchmark);
+            results.push_back(result);
+
+            std::cout << std::left << std::setw(28) << result.name << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(14) << result.nsPerOp
+                      << std::setw(12) << result.bytesPerOp
+                      << std::setprecision(2) << std::setw(12) << result.allocsPerOp;
+
+            auto base = baseline.find(result.name);
+
+            if (base != baseline.end()) {
+                double change = (result.nsPerOp / base->second.nsPerOp - 1) * 100;
+                bool slower = change > threshold;
+                bool allocates = result.allocsPerOp > base->second.allocsPerOp + 0.01
+                                 || result.bytesPerOp > base->second.bytesPerOp * 1.01 + 1;
+
+                std::cout << std::setprecision(1) << std::setw(11) << std::showpos << change << '%' << std::noshowpos;
+
+                if (slower || allocates) {
+                    std::cout << "  REGRESSION" << (slower ? " (time)" : "") << (allocates ? " (allocations)" : "");
+                    ++regressions;
+                }
+            }
+
+            std::cout << '\n';
+        }
+
+        std::remove(summaryFile.c_str());
+
+        if (!saveFile.empty()) {
+            saveBaseline(saveFile, results);
+            std::cout << "baseline saved to " << saveFile << '\n';
+        }
+
+        if (regressions > 0) {
+            std::cout << regressions << " regression(s) against " << compareFile << '\n';
+            return 1;
+        }
+    } catch (std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+#include "EventStore.h"
+
+// One reader thread keeps summarizing a large channel while writer threads
+// ingest into other channels. Runs once with every operation behind a single
+// global mutex (how the store used to be guarded) and once with the store's
+// own per-channel locking, and prints the ingest rate of both.
+
+using Clock = std::chrono::steady_clock;
+
+static const char* CHANNELS[] = {"fire", "medical", "rescue", "hazmat", "traffic", "coast", "air", "k9"};
+
+std::string eventBody(int i)
+{
+    return "user:bob\n"
+           "city:Liberty City\n"
+           "event name:Incident " + std::to_string(i) + "\n"
+           "date time:" + std::to_string(1735000000 + i) + "\n"
+           "general information:\n"
+           "\tactive:true\n"
+           "\tforces_arrival_at_scene:false\n"
+           "description:" + std::string(200, 'x');
+}
+
+struct Result
+{
+    double ingestRate;
+    double summaryRate;
+};
+
+Result run(bool globalLock, size_t writers, double seconds, int prefill)
+{
+    EventStore store;
+    std::mutex global;
+    std::string body = eventBody(0);
+    EventFields fields = EventFields::parse(body);
+
+    for (int i = 0; i < prefill; ++i)
+        store.insert("police", fields);
+
+    std::atomic<bool> running(true);
+    std::atomic<size_t> inserted(0);
+    std::atomic<size_t> summaries(0);
+    std::vector<std::thread> threads;
+
+    for (size_t w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w]() {
+            const std::string channel = CHANNELS[w % 8] + std::to_string(w / 8);
+            std::string writerBody = eventBody(static_cast<int>(w));
+            EventFields writerFields = EventFields::parse(writerBody);
+            size_t count = 0;
+
+            while (running.load(std::memory_order_relaxed)) {
+                if (globalLock) {
+                    std::lock_guard<std::mutex> lck(global);
+                    store.insert(channel, writerFields);
+                } else {
+                    store.insert(channel, writerFields);
+                }
+                ++count;
+            }
+
+            inserted += count;
+        });
+    }
+
+    threads.emplace_back([&]() {
+        while (running.load(std::memory_order_relaxed)) {
+            std::vector<Event> reports;
+
+            if (globalLock) {
+                std::lock_guard<std::mutex> lck(global);
+                reports = store.reportsFrom("police", "bob");
+            } else {
+                reports = store.reportsFrom("police", "bob");
+            }
+
+            std::sort(reports.begin(), reports.end(), [](const Event& a, const Event& b) {
+                return a.get_date_time() < b.get_date_time();
+            });
+
+            ++summaries;
+        }
+    });
+
+    Clock::time_point start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    running.store(false);
+
+    for (std::thread& t : threads) t.join();
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    return {inserted / elapsed, summaries / elapsed};
+}
+
+int main(int argc, char** argv)
+{
+    size_t writers = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 3;
+    double seconds = (argc > 2) ? std::atof(argv[2]) : 2.0;
+    int prefill = (argc > 3) ? std::atoi(argv[3]) : 20000;
+
+    std::cout << writers << " writer(s), 1 summarizing reader, " << prefill
+              << " events in the summarized channel, " << seconds << "s per run\n\n";
+
+    Result global = run(true, writers, seconds, prefill);
+    Result sharded = run(false, writers, seconds, prefill);
+
+    std::cout << std::fixed << std::setprecision(0)
+              << std::left << std::setw(16) << "locking"
+              << std::right << std::setw(16) << "inserts/s" << std::setw(16) << "summaries/s" << '\n'
+              << std::left << std::setw(16) << "global mutex"
+              << std::right << std::setw(16) << global.ingestRate << std::setw(16) << global.summaryRate << '\n'
+              << std::left << std::setw(16) << "per channel"
+              << std::right << std::setw(16) << sharded.ingestRate << std::setw(16) << sharded.summaryRate << '\n'
+              << std::setprecision(2) << "\ningest speedup: " << sharded.ingestRate / global.ingestRate << "x\n";
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <boost/asio.hpp>
+
+class StompProtocol;
+
+
+// Serves one long-lived session to local commands over a Unix domain socket,
+// so a task pays neither process startup nor the broker handshake. Each
+// request is one command line, in the syntax Parser::parseCommand reads; the
+// reply is what the command printed, ended by a '\0'. Output that arrives
+// later from the broker, like "Login successful", stays on the daemon's log.
+// Commands run one at a time on the protocol's io_context, each front end's
+// waiting while another's is still running, like a bench; 'quit' stops the
+// daemon once its reply is sent.
+class ControlServer
+{
+public:
+    ControlServer(StompProtocol& protocol, const std::string& path);
+    ~ControlServer();
+
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    void run(); // returns after 'quit'
+
+    static const char REPLY_END = '\0';
+
+private:
+    class Session;
+
+    StompProtocol& _protocol;
+    std::string _path;
+    boost::asio::local::stream_protocol::acceptor _acceptor;
+
+    void accept();
+    void execute(const std::string& command, std::ostringstream& out, std::function<void()> done);
+    void stop();
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Event.h"
+#include "SpscQueue.h"
+
+class Frame;
+
+
+// Worker threads that parse and handle raw MESSAGE frames in parallel.
+// Frames are sharded by destination, so every frame of a channel goes to the
+// same worker and the channel's events are handled in the order they arrived.
+// submit() must always be called from the same single thread.
+class DecoderPool
+{
+public:
+    using Handler = std::function<void(const Frame&)>;
+
+    DecoderPool(size_t workers, size_t queueCapacity, Handler handler);
+    DecoderPool(const DecoderPool&) = delete;
+    DecoderPool& operator=(const DecoderPool&) = delete;
+    ~DecoderPool();
+
+    void start();
+    void stop(); // handles everything already submitted, then joins the workers
+    void submit(std::string&& rawFrame);
+
+    size_t size() const;
+    std::vector<QueueStats> queueStats() const;
+    bool idle() const; // every submitted frame has been handled
+
+    // the destination of a raw MESSAGE frame, empty for any other frame
+    static StringRef messageDestination(const std::string& rawFrame);
+
+private:
+    struct Worker
+    {
+        SpscQueue<std::string> queue;
+        QueueWaiter waiter;
+        std::thread thread;
+        std::atomic<uint64_t> submitted;
+        std::atomic<uint64_t> handled;
+
+        explicit Worker(size_t capacity);
+    };
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    Handler _handler;
+    std::atomic<bool> _running;
+
+    void run(Worker& worker);
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include "Event.h"
+#include "Slab.h"
+#include "LockProfiler.h"
+
+
+// String whose characters live inside a channel's slab
+struct SlabString
+{
+    const char* data;
+    uint32_t length;
+
+    std::string str() const;
+};
+
+// Compact form of an Event as kept in the store
+struct EventRecord
+{
+    SlabString owner;
+    SlabString city;
+    SlabString name;
+    SlabString description;
+    int datetime;
+    uint32_t infoCount;
+    const SlabString* info; // infoCount key/value pairs, laid out key, value, key, value...
+};
+
+struct ChannelMemory
+{
+    std::string channel;
+    size_t events;
+    size_t used;
+    size_t reserved;
+
+    double fragmentation() const;
+};
+
+// Received events, grouped by channel and then by the user who reported them.
+// Each channel allocates its records and their strings from its own slabs.
+// Thread safe: the channel map is only locked to find or create a channel,
+// and each channel is then read and written under its own lock.
+class EventStore
+{
+public:
+    EventStore();
+    EventStore(const EventStore&) = delete;
+    EventStore& operator=(const EventStore&) = delete;
+
+    void insert(const std::string& channel, const Event& event);
+    void insert(const std::string& channel, const EventFields& fields);
+    std::vector<Event> reportsFrom(const std::string& channel, const std::string& user) const;
+    std::vector<ChannelMemory> memoryUsage() const;
+    void clear();
+
+private:
+    class Channel
+    {
+    public:
+        explicit Channel(const std::string& name);
+        Channel(const Channel&) = delete;
+        Channel& operator=(const Channel&) = delete;
+
+        void insert(const Event& event);
+        void insert(const EventFields& fields);
+        std::vector<Event> reportsFrom(const std::string& user) const;
+        ChannelMemory memoryUsage() const;
+
+    private:
+        std::string _name;
+        mutable ProfiledMutex _mtx;
+        Slab _records;
+        Slab _strings;
+        size_t _count;
+        std::unordered_map<std::string, std::vector<const EventRecord*>> _byOwner;
+
+        EventRecord* newRecord(const char* owner, size_t ownerLength);
+        SlabString store(const char* data, size_t length);
+        SlabString store(const std::string& s);
+        Event toEvent(const EventRecord& record) const;
+    };
+
+    std::unordered_map<std::string, std::shared_ptr<Channel>> _channels;
+    mutable ProfiledMutex _mtxChannels;
+
+    std::shared_ptr<Channel> channel(const std::string& name);
+    std::shared_ptr<Channel> findChannel(const std::string& name) const;
+};
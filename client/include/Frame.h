@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "Event.h"
+
+
+enum class FrameType
+{
+    CONNECT,
+    SEND,
+    SUBSCRIBE,
+    UNSUBSCRIBE,
+    DISCONNECT,
+    CONNECTED,
+    MESSAGE,
+    RECEIPT,
+    ERROR
+};
+
+// A side's heart-beat header: how often it can send, and how often it wants
+// to receive, in ms; 0 means never
+struct HeartBeat
+{
+    uint32_t send;
+    uint32_t receive;
+
+    std::string toString() const;
+    static HeartBeat parse(const std::string& header); // a missing header is 0,0; throws on a malformed one
+
+    // how often sender must send to receiver, as agreed by their two headers
+    static uint32_t interval(uint32_t senderSend, uint32_t receiverReceive);
+};
+
+class Frame
+{
+public:
+    FrameType type() const;
+    const std::string& getHeader(const std::string& header) const;
+    const std::string& body() const;
+    const std::unordered_map<std::string, std::string>& headers() const;
+    void setHeader(const std::string& header, std::string value);
+
+    std::string raw() const;
+    static Frame parseFrame(const std::string& frame);
+    static Frame parseFrame(std::string&& frame);
+    static const std::string& getFrameName(FrameType t);
+    static FrameType getFrameType(const std::string& name);
+
+    static Frame Connect(const std::string& user, const std::string& password, HeartBeat heartBeat = {0, 0});
+    static Frame Disconnect(int receipt);
+    static Frame Subscribe(const std::string& topic, int id, int receipt);
+    static Frame Unsubscribe(int id, int receipt);
+    static Frame Send(const Event& event);
+    static Frame Send(const Event& event, int receipt);
+
+    static Frame Connected(const std::string& version, HeartBeat heartBeat = {0, 0});
+    static Frame Receipt(const std::string& receiptId);
+    static Frame Error(const std::string& message);
+    
+private:
+    FrameType _type;
+    std::unordered_map<std::string, std::string> _headers;
+    std::string _body;
+
+    Frame(FrameType type, std::unordered_map<std::string, std::string> headers);
+    Frame(FrameType type, std::unordered_map<std::string, std::string> headers, std::string body);
+
+    static size_t parseHead(const std::string& frame, FrameType& type, std::unordered_map<std::string, std::string>& headers);
+};
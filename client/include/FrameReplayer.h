@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class StompProtocol;
+
+
+// A raw frame as it came off the wire, terminating '\0' included, and when it
+// arrived in seconds from the start of its recording
+struct TimedFrame
+{
+    double time;
+    std::string bytes;
+};
+
+struct ReplayResult
+{
+    size_t frames;
+    size_t messages;  // MESSAGE frames handled by the protocol
+    size_t bytes;
+    double seconds;   // from the first byte written to the last message handled
+    bool complete;    // every MESSAGE was handled before the timeout
+};
+
+// Plays recorded broker-to-client traffic into a StompProtocol. The frames
+// are served from a loopback socket the protocol logs in to, so they take the
+// same readFrame/parseFrame/handleMessage path as live traffic.
+class FrameReplayer
+{
+public:
+    explicit FrameReplayer(StompProtocol& protocol);
+    FrameReplayer(const FrameReplayer&) = delete;
+    FrameReplayer& operator=(const FrameReplayer&) = delete;
+
+    // speed 1 keeps the recorded pacing, 10 plays ten times faster and
+    // 0 writes everything as fast as the socket takes it.
+    // The protocol is logged in as user and disconnected when done; its
+    // message listener is replaced to follow progress.
+    ReplayResult replay(const std::vector<TimedFrame>& frames, double speed,
+                        const std::string& user, const std::string& passcode);
+
+    static bool isMessage(const std::string& rawFrame);
+
+private:
+    StompProtocol& _protocol;
+};
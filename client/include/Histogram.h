@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// Log-linear histogram in the style of HdrHistogram: every power of two is
+// split into 64 linear sub-buckets, so any recorded value is reproduced
+// within ~1.6% over the whole 64-bit range using fixed memory.
+// Not thread safe; keep one per thread and merge() them to report.
+class Histogram
+{
+public:
+    Histogram();
+
+    void record(uint64_t value);
+    void merge(const Histogram& other);
+    void reset();
+
+    uint64_t count() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+    uint64_t percentile(double percent) const;
+
+    // p50/p99/p99.9/max on one line, values divided by unitScale
+    void printSummary(std::ostream& out, double unitScale, const std::string& unit) const;
+    // HdrHistogram-style percentile distribution table
+    void printDistribution(std::ostream& out, double unitScale, const std::string& unit) const;
+
+private:
+    static const unsigned SUB_BUCKET_BITS = 6;
+    static const uint64_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+
+    std::vector<uint64_t> _counts;
+    uint64_t _count;
+    uint64_t _min;
+    uint64_t _max;
+    double _sum;
+
+    static size_t bucketOf(uint64_t value);
+    static uint64_t highestValueIn(size_t bucket);
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Histogram.h"
+
+
+// Spans of the client's hot paths that are timed into histograms
+enum class LatencySpan
+{
+    SOCKET_READ,        // taking a received frame out of the socket's read buffer
+    FRAME_PARSE,        // Frame::parseFrame of an inbound frame
+    EVENT_DECODE,       // EventFields::parse of a MESSAGE body
+    STORE_INSERT,       // EventStore::insert
+    FRAME_ENCODE,       // Frame::raw of an outbound frame
+    SOCKET_WRITE,       // writing an outbound frame to the socket
+    RECEIPT_ROUND_TRIP, // from sending a frame to handling its RECEIPT
+    COUNT
+};
+
+// Every thread records into histograms of its own; snapshot() merges them.
+// Recording takes an uncontended per-thread spin lock, which a snapshot only
+// holds while it copies that thread's histograms.
+// Building with -DSTOMP_NO_LATENCY compiles every LATENCY_* macro away.
+class Latency
+{
+public:
+    static const char* name(LatencySpan span);
+    static bool enabled();
+
+    static int64_t now(); // monotonic ns
+    static void record(LatencySpan span, int64_t ns);
+
+    // one histogram per span, in LatencySpan order, merged over all threads
+    static std::vector<Histogram> snapshot();
+    static void reset();
+};
+
+// Times the scope it lives in
+class LatencyScope
+{
+public:
+    explicit LatencyScope(LatencySpan span) : _span(span), _start(Latency::now()) {}
+    ~LatencyScope() { Latency::record(_span, Latency::now() - _start); }
+
+    LatencyScope(const LatencyScope&) = delete;
+    LatencyScope& operator=(const LatencyScope&) = delete;
+
+private:
+    LatencySpan _span;
+    int64_t _start;
+};
+
+template <typename F>
+auto latencyTimed(LatencySpan span, F f) -> decltype(f())
+{
+    LatencyScope scope(span);
+    return f();
+}
+
+#ifndef STOMP_NO_LATENCY
+#define LATENCY_CONCAT_(a, b) a##b
+#define LATENCY_CONCAT(a, b) LATENCY_CONCAT_(a, b)
+// times the rest of the enclosing block
+#define LATENCY_SCOPE(span) LatencyScope LATENCY_CONCAT(latencyScope, __LINE__)(LatencySpan::span)
+// evaluates expr and times it
+#define LATENCY_TIMED(span, expr) latencyTimed(LatencySpan::span, [&]() { return expr; })
+// records a duration measured elsewhere
+#define LATENCY_RECORD(span, ns) Latency::record(LatencySpan::span, ns)
+#define LATENCY_NOW() Latency::now()
+#else
+#define LATENCY_SCOPE(span)
+#define LATENCY_TIMED(span, expr) (expr)
+#define LATENCY_RECORD(span, ns) ((void)0)
+#define LATENCY_NOW() int64_t(0)
+#endif
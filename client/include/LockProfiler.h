@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Histogram.h"
+
+
+struct LockStats
+{
+    std::string site;
+    uint64_t acquisitions;
+    uint64_t contended;   // acquisitions that had to wait for another thread
+    uint64_t totalWaitNs;
+    uint64_t maxWaitNs;
+    Histogram holdNs;
+
+    LockStats() : site(), acquisitions(0), contended(0), totalWaitNs(0), maxWaitNs(0), holdNs() {}
+};
+
+// Where a lock is taken. Every ProfiledMutex made for the same site name adds
+// to the same statistics, e.g. all of the event store's per-channel locks.
+// Each thread counts into a record of its own, which stats() merges, so
+// profiling never makes the locks it measures share anything more.
+class LockSite
+{
+public:
+    LockSite(const char* name, size_t index);
+    LockSite(const LockSite&) = delete;
+    LockSite& operator=(const LockSite&) = delete;
+
+    void acquired(int64_t waitNs);
+    void released(int64_t holdNs);
+
+    LockStats stats();
+    void reset();
+
+private:
+    const char* _name;
+    size_t _index; // of this site's record in every thread's
+};
+
+// Profiling is off until enabled; a lock then costs one relaxed load more
+// than a plain std::mutex. Sites are never destroyed.
+class LockProfiler
+{
+public:
+    static void enable(bool on);
+    static bool enabled() { return _sEnabled.load(std::memory_order_relaxed); }
+
+    static LockSite& site(const char* name);
+    static std::vector<LockStats> snapshot(); // sites in the order they were first used
+    static void reset();
+
+private:
+    static std::atomic<bool> _sEnabled;
+};
+
+// std::mutex that reports its waits and hold times to its site while the
+// profiler is enabled. Usable wherever a std::mutex is (lock_guard, unique_lock).
+class ProfiledMutex
+{
+public:
+    explicit ProfiledMutex(const char* site);
+    ProfiledMutex(const ProfiledMutex&) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    // lock(), returning how long it waited for another thread: 0 when it
+    // did not have to. The whole acquisition is timed.
+    int64_t lockWaiting();
+
+private:
+    std::mutex _mtx;
+    LockSite& _site;
+    int64_t _acquiredAt; // written by the holder only, 0 when taken while profiling was off
+};
+
+// for TracedLock, which then reports the same wait as the profiler
+inline int64_t lockWaiting(ProfiledMutex& m)
+{
+    return m.lockWaiting();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "SpscQueue.h"
+
+
+enum class LogLevel
+{
+    DEBUG,
+    INFO,
+    WARN,
+    ERROR,
+    OFF
+};
+
+// What a producer does when the log queue is full
+enum class LogOverflow
+{
+    DROP,  // discard the line and count it, never stalling the caller
+    BLOCK  // wait for room, for when every line matters more than latency
+};
+
+struct LogStats
+{
+    uint64_t written;
+    uint64_t dropped;
+    QueueStats queue;
+};
+
+// Console output of the client's network threads. A producer only builds its
+// line and pushes it into a lock-free queue; a background thread writes DEBUG
+// and INFO lines to stdout, WARN and ERROR lines to stderr, in queue order.
+// Lines still queued at exit are written before the process ends.
+class Log
+{
+public:
+    static void debug(std::string line);
+    static void info(std::string line);
+    static void warn(std::string line);
+    static void error(std::string line);
+    static void write(LogLevel level, std::string line);
+
+    static void setLevel(LogLevel level);
+    static LogLevel level();
+    static void setOverflow(LogOverflow overflow);
+    static LogOverflow overflow();
+
+    static void flush(); // returns once every line queued before the call is written
+    static LogStats stats();
+
+    static LogLevel parseLevel(const std::string& name);
+    static const char* levelName(LogLevel level);
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+
+#include "Frame.h"
+
+class StompProtocol;
+
+
+// Counters a StompProtocol keeps about its connection. Hot paths only do
+// relaxed increments; readers get a close-enough view, not a consistent one.
+struct ClientMetrics
+{
+    static const size_t FRAME_TYPES = static_cast<size_t>(FrameType::ERROR) + 1;
+
+    std::atomic<uint64_t> framesIn[FRAME_TYPES];
+    std::atomic<uint64_t> framesOut[FRAME_TYPES];
+    std::atomic<uint64_t> bytesIn;
+    std::atomic<uint64_t> bytesOut;
+    std::atomic<uint64_t> connects;
+    std::atomic<uint64_t> reconnects;
+    std::atomic<uint64_t> outageNs;     // from losing a connection to CONNECTED on its replacement
+    std::atomic<uint64_t> lastOutageNs;
+    std::atomic<uint64_t> receiptTimeouts;
+    std::atomic<uint64_t> heartBeatTimeouts;
+
+    ClientMetrics();
+    ClientMetrics(const ClientMetrics&) = delete;
+    ClientMetrics& operator=(const ClientMetrics&) = delete;
+
+    static void add(std::atomic<uint64_t>& counter, uint64_t n = 1)
+    {
+        counter.fetch_add(n, std::memory_order_relaxed);
+    }
+};
+
+// Publishes a StompProtocol's metrics in the Prometheus text exposition
+// format, by rewriting a file periodically (for node_exporter's textfile
+// collector) and/or over HTTP on the loopback interface.
+class MetricsExporter
+{
+public:
+    explicit MetricsExporter(StompProtocol& protocol);
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+    ~MetricsExporter();
+
+    void writeFile(const std::string& path, double intervalSeconds);
+    unsigned short serveHttp(unsigned short port); // 0 picks a free port, which is returned
+    std::string describe() const;
+
+    static std::string render(StompProtocol& protocol);
+
+private:
+    StompProtocol& _protocol;
+    boost::asio::io_context _ioContext;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> _work;
+    std::thread _thread;
+
+    std::unique_ptr<boost::asio::steady_timer> _timer;
+    std::string _path;
+    double _intervalSeconds;
+
+    std::unique_ptr<boost::asio::ip::tcp::acceptor> _acceptor;
+
+    void run();
+    void scheduleWrite();
+    void writeNow();
+    void accept();
+};
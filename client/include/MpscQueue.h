@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "SpscQueue.h"
+
+
+// Bounded lock-free ring buffer for any number of producer threads and one
+// consumer thread (Vyukov's bounded queue). Every slot carries a sequence
+// number that tells producers and the consumer whose turn the slot is, so
+// neither side ever blocks; tryPush/tryPop fail instead.
+template <typename T>
+class MpscQueue
+{
+public:
+    explicit MpscQueue(size_t capacity)
+        : _capacity(roundUp(capacity))
+        , _slots(new Slot[_capacity])
+        , _mask(_capacity - 1)
+        , _pad0()
+        , _head(0)
+        , _pad1()
+        , _tail(0)
+        , _pad2()
+        , _highWater(0)
+        , _pad3()
+    {
+        for (size_t i = 0; i < _capacity; ++i)
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // producer side, any thread
+    bool tryPush(T&& item)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        Slot* slot;
+
+        while (true) {
+            slot = &_slots[tail & _mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t turn = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(tail);
+
+            if (turn == 0) {
+                if (_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed))
+                    break;
+            } else if (turn < 0) {
+                return false; // full: the consumer has not freed this slot yet
+            } else {
+                tail = _tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->item = std::move(item);
+        slot->sequence.store(tail + 1, std::memory_order_release);
+
+        size_t depth = tail + 1 - _head.load(std::memory_order_relaxed);
+        if (depth > _highWater.load(std::memory_order_relaxed))
+            _highWater.store(depth, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    // consumer side
+    bool tryPop(T& item)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        Slot& slot = _slots[head & _mask];
+
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+            return false;
+
+        item = std::move(slot.item);
+        slot.sequence.store(head + _capacity, std::memory_order_release);
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // safe to call from any thread; may be slightly stale
+    size_t size() const
+    {
+        size_t head = _head.load(std::memory_order_acquire);
+        size_t tail = _tail.load(std::memory_order_acquire);
+        return (tail > head) ? tail - head : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    QueueStats stats() const
+    {
+        return {size(), _highWater.load(std::memory_order_relaxed), _capacity};
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        T item;
+
+        Slot() : sequence(0), item() {}
+    };
+
+    size_t _capacity;
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask;
+
+    char _pad0[64];
+    std::atomic<size_t> _head; // written by the consumer
+    char _pad1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> _tail; // claimed by producers
+    char _pad2[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> _highWater;
+    char _pad3[64 - sizeof(std::atomic<size_t>)];
+
+    static size_t roundUp(size_t n)
+    {
+        size_t capacity = 1;
+        while (capacity < n) capacity <<= 1;
+        return capacity;
+    }
+};
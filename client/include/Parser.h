@@ -3,6 +3,8 @@
 #include <string>
 #include <vector>
 #include <ctime>
+#include <memory>
+#include <functional>
 
 #include "StompProtocol.h"
 #include "Event.h"
@@ -14,12 +16,29 @@ public:
     static bool shouldQuit();
     static void parseCommand(const std::string&, StompProtocol&);
 
-private:
-    static bool _sQuit;
+    // A command can go on running on the protocol's io_context after
+    // parseCommand returns, like bench. done runs on the loop once it has
+    // finished, or right away; input is not read again until then.
+    static bool isBusy();
+    static void whenDone(std::function<void()> done);
+
+    // report for events already read from their file, as a script does
+    // once it has taken their channel; errors print as in parseCommand
+    static void reportEvents(std::vector<Event>& events, StompProtocol&);
 
-    static std::vector<std::string> parseArgs(const std::string& input);
     static void writeSummary(const std::string& fileName, const std::vector<Event>& reports);
     static std::string epochToString(time_t val);
+    static std::vector<std::string> parseArgs(const std::string& input);
+
+private:
+    static bool _sQuit;
+    static bool _sBusy;
+    static std::vector<std::function<void()>> _sWhenDone;
+    static std::unique_ptr<MetricsExporter> _sMetrics; // reset by quit, before the protocol it reads goes away
+
+    static void commandDone();
+    static void runCommand(const std::function<void()>& command, StompProtocol&);
+    static void sendReports(std::vector<Event>& events, StompProtocol&);
 
     static void login(const std::vector<std::string>&, StompProtocol&);
     static void join(const std::vector<std::string>&, StompProtocol&);
@@ -28,4 +47,15 @@ private:
     static void summary(const std::vector<std::string>&, StompProtocol&);
     static void logout(const std::vector<std::string>&, StompProtocol&);
     static void quit(const std::vector<std::string>&, StompProtocol&);
+    static void mem(const std::vector<std::string>&, StompProtocol&);
+    static void queue(const std::vector<std::string>&, StompProtocol&);
+    static void record(const std::vector<std::string>&, StompProtocol&);
+    static void bench(const std::vector<std::string>&, StompProtocol&);
+    static void latency(const std::vector<std::string>&, StompProtocol&);
+    static void metrics(const std::vector<std::string>&, StompProtocol&);
+    static void trace(const std::vector<std::string>&, StompProtocol&);
+    static void locks(const std::vector<std::string>&, StompProtocol&);
+    static void log(const std::vector<std::string>&, StompProtocol&);
+    static void reconnect(const std::vector<std::string>&, StompProtocol&);
+    static void heartbeat(const std::vector<std::string>&, StompProtocol&);
 };
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "FrameReplayer.h"
+
+
+// One TCP connection of a STOMP session reassembled from a capture, split
+// into frames in both directions. Frame times are seconds since the first
+// packet of the capture.
+struct TcpConversation
+{
+    std::string client;  // address:port
+    std::string server;
+    std::vector<TimedFrame> clientFrames;
+    std::vector<TimedFrame> serverFrames;
+    size_t missingBytes; // sequence gaps the capture did not cover
+
+    TcpConversation() : client(), server(), clientFrames(), serverFrames(), missingBytes(0) {}
+
+    // reads a classic libpcap file (not pcapng) with Ethernet, Linux cooked,
+    // BSD loopback or raw IP framing
+    static std::vector<TcpConversation> fromPcapFile(const std::string& path);
+
+    // the login and passcode of the first CONNECT the client sent
+    std::string login() const;
+    std::string passcode() const;
+};
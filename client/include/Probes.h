@@ -0,0 +1,26 @@
+#pragma once
+
+// USDT probes of provider "stomp" for bpftrace, perf and SystemTap; see
+// tools/bpftrace. An unattached probe is a single nop and its arguments are
+// only ever registers or stack slots, so they stay in release builds.
+// Built with -DSTOMP_USDT, which the makefile sets when <sys/sdt.h> exists;
+// without it every STOMP_PROBE* compiles to nothing.
+//
+//   frame__received  (const char* command, size_t bytes)
+//   frame__sent      (const char* command, size_t bytes)
+//   message__stored  (const char* channel, const char* owner, size_t ownerLength)
+//   receipt__matched (const char* receiptId, const char* command, int64_t roundTripNs)
+//   lock__acquired   (const char* lock, int64_t waitNs)
+//   lock__released   (const char* lock)
+
+#ifdef STOMP_USDT
+#include <sys/sdt.h>
+#define STOMP_PROBE1(name, a) DTRACE_PROBE1(stomp, name, a)
+#define STOMP_PROBE2(name, a, b) DTRACE_PROBE2(stomp, name, a, b)
+#define STOMP_PROBE3(name, a, b, c) DTRACE_PROBE3(stomp, name, a, b, c)
+#else
+// sizeof keeps the arguments used without evaluating them
+#define STOMP_PROBE1(name, a) ((void)sizeof(a))
+#define STOMP_PROBE2(name, a, b) ((void)sizeof(a), (void)sizeof(b))
+#define STOMP_PROBE3(name, a, b, c) ((void)sizeof(a), (void)sizeof(b), (void)sizeof(c))
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "Event.h"
+
+class StompProtocol;
+
+
+// Runs a list of client commands without a prompt and without waiting for
+// the broker after each one. A command is only held back while something it
+// depends on is still outstanding: a join waits for the login, a report for
+// the receipt of its channel's join, a summary for the receipts of the
+// reports before it. login, logout, quit and the local commands wait for
+// everything before them.
+class ScriptRunner
+{
+public:
+    explicit ScriptRunner(StompProtocol& protocol);
+
+    ScriptRunner(const ScriptRunner&) = delete;
+    ScriptRunner& operator=(const ScriptRunner&) = delete;
+
+    void load(std::istream& in);
+    void run();
+    void printTimings(std::ostream& out) const;
+
+private:
+    enum class Kind
+    {
+        LOGIN,
+        LOGOUT,
+        QUIT,
+        JOIN,
+        EXIT,
+        REPORT,
+        SUMMARY,
+        BARRIER // any other command
+    };
+
+    struct Step
+    {
+        size_t line;
+        std::string text;
+        Kind kind;
+        std::vector<size_t> after; // steps that must be complete before this one is issued
+        int firstReceipt;          // receipt ids [firstReceipt, lastReceipt) were sent by this step
+        int lastReceipt;
+        int64_t reachedNs; // the runner got to this step
+        int64_t issuedNs;
+        int64_t ranNs;
+        int64_t doneNs;
+        bool abandoned; // no longer waited for, after the timeout
+        bool eventsRead; // a report whose file load() already read: sends events, not the file again
+        std::vector<Event> events;
+    };
+
+    StompProtocol& _protocol;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> _work; // keeps pump() waiting while no read is pending
+    std::vector<Step> _steps;
+    size_t _completed; // every step before this one is complete
+    int64_t _startNs;
+
+    bool isReady(const Step& step);
+    bool isComplete(Step& step);
+    void updateCompleted(size_t issued);
+    bool waitUntilReady(size_t issued, const Step& step);
+
+    static Kind kindOf(const std::string& command);
+    static bool readReport(const std::string& file, std::vector<Event>& events);
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FrameReplayer.h"
+
+
+// Appends every inbound frame, with the monotonic time it was read, to a
+// recording file that FrameReplayer can play back.
+//
+// File format: the magic "STOMPREC" and a version byte, then records.
+//   'S' <varint wall-clock ns>                 a recording session starts
+//   'F' <varint ns since the previous record>   a frame, without its '\0'
+//       <varint length> <bytes>
+// Integers are unsigned LEB128. Every start() appends a new session.
+class SessionRecorder
+{
+public:
+    SessionRecorder();
+    SessionRecorder(const SessionRecorder&) = delete;
+    SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+    void start(const std::string& path);
+    void stop();
+    bool isRecording() const;
+    std::string path() const;
+    uint64_t framesRecorded() const;
+
+    // called by the socket reader for every frame; cheap when not recording
+    void record(const std::string& rawFrame);
+
+    // every frame of every session in a recording, sessions played back to
+    // back; frames get their '\0' back
+    static std::vector<TimedFrame> load(const std::string& path, size_t* sessions = nullptr);
+
+private:
+    std::atomic<bool> _recording;
+    mutable std::mutex _mtx;
+    std::ofstream _file;
+    std::string _path;
+    std::vector<char> _buffer;
+    uint64_t _lastNs;
+    uint64_t _frames;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+
+// Bump allocator that carves allocations out of fixed-size blocks.
+// Nothing is released individually; all memory goes away with the slab.
+class Slab
+{
+public:
+    explicit Slab(size_t blockSize);
+    Slab(const Slab&) = delete;
+    Slab& operator=(const Slab&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+    const char* copy(const char* data, size_t length); // an empty copy takes no space
+
+    template <typename T>
+    T* allocate(size_t count = 1)
+    {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    size_t used() const;
+    size_t reserved() const;
+
+private:
+    size_t _blockSize;
+    std::vector<std::unique_ptr<char[]>> _blocks;
+    size_t _offset; // first free byte in _blocks.back()
+    size_t _used;
+    size_t _reserved;
+
+    char* newBlock(size_t size);
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+struct QueueStats
+{
+    size_t depth;
+    size_t highWaterMark;
+    size_t capacity;
+};
+
+// Bounded lock-free ring buffer for exactly one producer thread and one
+// consumer thread. Neither side ever blocks; tryPush/tryPop fail instead.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        : _slots(roundUp(capacity))
+        , _mask(_slots.size() - 1)
+        , _pad0()
+        , _head(0)
+        , _pad1()
+        , _tail(0)
+        , _pad2()
+        , _highWater(0)
+        , _pad3()
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // producer side
+    bool tryPush(T&& item)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        size_t depth = tail - _head.load(std::memory_order_acquire);
+
+        if (depth == _slots.size())
+            return false;
+
+        _slots[tail & _mask] = std::move(item);
+        _tail.store(tail + 1, std::memory_order_release);
+
+        if (depth + 1 > _highWater.load(std::memory_order_relaxed))
+            _highWater.store(depth + 1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    // consumer side
+    bool tryPop(T& item)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+
+        if (head == _tail.load(std::memory_order_acquire))
+            return false;
+
+        item = std::move(_slots[head & _mask]);
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // safe to call from any thread; may be slightly stale
+    size_t size() const
+    {
+        size_t head = _head.load(std::memory_order_acquire);
+        size_t tail = _tail.load(std::memory_order_acquire);
+        return (tail > head) ? tail - head : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    size_t highWaterMark() const
+    {
+        return _highWater.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity() const
+    {
+        return _slots.size();
+    }
+
+    QueueStats stats() const
+    {
+        return {size(), highWaterMark(), capacity()};
+    }
+
+private:
+    std::vector<T> _slots;
+    size_t _mask;
+
+    // padding keeps the indices written by different threads on separate
+    // cache lines without making the queue over-aligned
+    char _pad0[64];
+    std::atomic<size_t> _head; // written by the consumer
+    char _pad1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> _tail; // written by the producer
+    char _pad2[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> _highWater;
+    char _pad3[64 - sizeof(std::atomic<size_t>)];
+
+    static size_t roundUp(size_t n)
+    {
+        size_t capacity = 1;
+        while (capacity < n) capacity <<= 1;
+        return capacity;
+    }
+};
+
+// How a consumer waits on an empty queue: it spins briefly, then yields,
+// then sleeps until a producer wakes it, so an idle connection costs no
+// CPU. A producer calls notify() after every push; that is one fence and a
+// load while the consumer is awake.
+class QueueWaiter
+{
+public:
+    QueueWaiter()
+        : _mtx()
+        , _cv()
+        , _sleeping(false)
+    {
+    }
+
+    QueueWaiter(const QueueWaiter&) = delete;
+    QueueWaiter& operator=(const QueueWaiter&) = delete;
+
+    // producer side, after a push or anything else the consumer waits for
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (!_sleeping.load(std::memory_order_relaxed))
+            return;
+
+        // taken so the wake-up cannot fall between the consumer's last check and its wait
+        { std::lock_guard<std::mutex> lck(_mtx); }
+        _cv.notify_all();
+    }
+
+    // consumer side, after a failed poll; idle counts the failed polls.
+    // Returns once ready() may hold, which the caller polls for again.
+    template <typename Ready>
+    void backoff(size_t idle, Ready ready)
+    {
+        if (idle < SPIN_POLLS)
+            return;
+
+        if (idle < SPIN_POLLS + YIELD_POLLS) {
+            std::this_thread::yield();
+            return;
+        }
+
+        std::unique_lock<std::mutex> lck(_mtx);
+        _sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with notify()'s
+
+        while (!ready())
+            _cv.wait(lck);
+
+        _sleeping.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    static const size_t SPIN_POLLS = 64;
+    static const size_t YIELD_POLLS = 64;
+
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    std::atomic<bool> _sleeping;
+};
@@ -1,96 +1,207 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include <atomic>
 #include <mutex>
 #include <memory>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <random>
 #include <boost/asio.hpp>
 
 #include "Event.h"
+#include "Frame.h"
+#include "EventStore.h"
+#include "SpscQueue.h"
+#include "DecoderPool.h"
+#include "SessionRecorder.h"
+#include "Metrics.h"
+#include "LockProfiler.h"
+#include "Transport.h"
 
 
-enum class FrameType
-{
-    CONNECT,
-    SEND,
-    SUBSCRIBE,
-    UNSUBSCRIBE,
-    DISCONNECT,
-    CONNECTED,
-    MESSAGE,
-    RECEIPT,
-    ERROR
-};
-
-class Frame
+class StompProtocol
 {
 public:
-    FrameType type() const;
-    const std::string getHeader(const std::string& header) const;
-    const std::string& body() const;
-
-    std::string raw() const;
-    static Frame parseFrame(const std::string& frame);
-    static const std::string& getFrameName(FrameType t);
-    static FrameType getFrameType(const std::string& name);
-
-    static Frame Connect(const std::string& user, const std::string& password);
-    static Frame Disconnect(int receipt);
-    static Frame Subscribe(const std::string& topic, int id, int receipt);
-    static Frame Unsubscribe(int id, int receipt);
-    static Frame Send(const Event& event);
-    static Frame Send(const Event& event, int receipt);
-    
-private:
-    FrameType _type;
-    std::unordered_map<std::string, std::string> _headers;
-    std::string _body;
+    // called for every MESSAGE before it is stored; returning true keeps it out of the store
+    using MessageListener = std::function<bool(const Frame&)>;
 
-    Frame(FrameType type, const std::unordered_map<std::string, std::string>& headers);
-    Frame(FrameType type, const std::unordered_map<std::string, std::string>& headers, const std::string& body);
-};
+    // MESSAGE frames carrying this header are benchmark traffic and never stored
+    static const char* const BENCH_HEADER;
 
-class StompProtocol
-{
-public:
-    StompProtocol();
+    // With ownLoop the socket is read on a thread of the protocol's own.
+    // Otherwise it is read by whichever thread runs ioContext(), so one
+    // thread can serve the socket and other I/O, like the console.
+    explicit StompProtocol(size_t decodeWorkers = defaultDecodeWorkers(), bool ownLoop = true);
     ~StompProtocol();
+
+    static size_t defaultDecodeWorkers();
+
+    boost::asio::io_context& ioContext();
+    // runs ready socket handlers for up to wait when the caller drives the
+    // loop, so it can wait on the broker; otherwise just sleeps. Never from
+    // a handler running on the loop, which would run other input in between.
+    void pump(std::chrono::milliseconds wait);
     
-    void closeConnection();
+    void closeConnection(); // safe from any thread
     void closeConnectionLogout();
     std::vector<Event> getReportsFrom(const std::string& channel, const std::string& user);
+    std::vector<ChannelMemory> getMemoryUsage();
+    QueueStats getQueueStats() const;
+    std::vector<QueueStats> getDecoderQueueStats() const;
+    SessionRecorder& recorder();
+    const ClientMetrics& getMetrics() const;
+    size_t getPendingReceipts();
+    size_t getOutboundQueueBytes(); // off the loop thread, the last snapshot taken on it
 
-    void login(const std::string& host, short port, const std::string& username, const std::string& password);
+    // address picks the transport: <host>:<port>, uring:<host>:<port>, unix:<path> or mem:<name>
+    void login(const std::string& address, const std::string& username, const std::string& password);
+
+    // Opt-in: a connection lost without a logout is re-established with
+    // jittered exponential backoff, replaying the CONNECT and every
+    // SUBSCRIBE back to back. Stored events are kept; logout gives up.
+    void setAutoReconnect(bool on);
+    bool autoReconnect() const;
+    bool isReconnecting() const;
+
+    // Heart-beat intervals the next CONNECT asks for. A broker that sends
+    // nothing for HEART_BEAT_TOLERANCE times the agreed receive interval is
+    // declared dead and its connection dropped, which auto-reconnect picks up.
+    // The receive interval also bounds the wait for CONNECTED.
+    static const int HEART_BEAT_TOLERANCE = 2;
+    void setHeartBeat(HeartBeat heartBeat);
+    HeartBeat heartBeat() const;
+    HeartBeat negotiatedHeartBeat() const; // of the current connection
     void logout();
     void subscribe(const std::string& topic);
     void unsubscribe(const std::string& topic);
     void report(Event& event);
+    void report(Event& event, const std::unordered_map<std::string, std::string>& headers);
+
+    bool isLoggedIn() const;
+    bool isReceiving() const; // false once the connection's reads have ended
+    bool isSubscribed(const std::string& topic);
+
+    // SENDs ask for a receipt, so a caller can tell when the broker has taken them
+    void setReportReceipts(bool on);
+    int nextReceiptId() const;
+    bool isReceiptPending(int from, int to); // any receipt id in [from, to) still unanswered
+    bool isDecodeIdle() const;               // every MESSAGE read so far has been stored
+    void setMessageListener(MessageListener listener); // safe to swap while frames arrive
+
+    void dispatch(const Frame& f);
 
 private:
     boost::asio::io_context _ioContext;
-    boost::asio::ip::tcp::socket _socket;
-    std::mutex _mtxSocket;
-    std::unique_ptr<Frame> _pLastFrame;
+    std::shared_ptr<Transport> _transport; // replaced only between connections
+    std::atomic<size_t> _outboundQueueBytes;
+    ProfiledMutex _mtxSocket;
+    std::shared_ptr<const Frame> _pLastFrame; // accessed with std::atomic_load/store
+    boost::asio::streambuf _readBuffer;
+
+    // frames sent with a receipt header, by receipt id, until their RECEIPT arrives
+    struct PendingReceipt
+    {
+        std::shared_ptr<const Frame> frame;
+        int64_t sentNs;
+        bool timedOut; // counted in receiptTimeouts
+
+        PendingReceipt() : frame(), sentNs(0), timedOut(false) {}
+        PendingReceipt(std::shared_ptr<const Frame> f, int64_t ns) : frame(std::move(f)), sentNs(ns), timedOut(false) {}
+    };
+
+    std::unordered_map<std::string, PendingReceipt> _pendingReceipts;
+    ProfiledMutex _mtxReceipts;
+    std::atomic<int> _nextReceiptId;
+    std::atomic<bool> _reportReceipts;
 
     std::atomic<bool> _loggedIn;
-    std::string _username;
+    std::string _username; // loop thread, once logged in
+
+    // the last login, and the channels it had joined when the connection was lost
+    struct Session
+    {
+        std::string username;
+        std::string password;
+        std::vector<std::string> topics;
+
+        Session() : username(), password(), topics() {}
+    };
+
+    Session _session;
+    std::atomic<bool> _autoReconnect;
+    std::atomic<bool> _reconnecting;
+    std::atomic<int64_t> _outageStartNs;
+    std::chrono::milliseconds _reconnectDelay; // before jitter; doubles per failed attempt
+    std::mt19937 _jitter;
+    boost::asio::steady_timer _reconnectTimer;
+
+    HeartBeat _heartBeat;
+    std::atomic<uint32_t> _heartBeatSend;    // agreed with the broker, ms
+    std::atomic<uint32_t> _heartBeatReceive;
+    std::atomic<int64_t> _lastSendNs;
+    uint64_t _bytesSeen;    // by the last liveness check; loop thread only
+    int64_t _lastReceiveNs;
+    boost::asio::steady_timer _heartBeatTimer;
+    boost::asio::steady_timer _livenessTimer;
+    boost::asio::steady_timer _receiptTimer;
     std::unordered_map<std::string, size_t> _subscriptions;
+    ProfiledMutex _mtxSubscriptions;
+    std::shared_ptr<const MessageListener> _messageListener; // accessed with std::atomic_load/store
     
-    std::unordered_map<std::string, std::unordered_map<std::string, std::vector<Event>>> _data;
-    std::mutex _mtxData;
+    EventStore _data;
+
+    // raw frames handed from the socket stage to the decode stage
+    SpscQueue<std::string> _inbound;
+    QueueWaiter _inboundWaiter; // woken by frames and by the end of the reads
+    std::atomic<bool> _reading;
+    bool _ownLoop;
+    std::atomic<unsigned> _generation; // bumped per connection, so stale read handlers stand down
+    std::thread _reader;
+    std::thread _decoder;
+
+    // MESSAGE frames are decoded and stored on these, sharded by channel
+    DecoderPool _decoders;
+
+    // inbound frames are appended to a recording while one is running
+    SessionRecorder _recorder;
+
+    ClientMetrics _metrics;
     
-    void send(const Frame& frame);
-    std::string readFrame();
+    void send(Frame frame);
+    std::string takeFrame(size_t length);
+
+    void closeTransport(); // on the loop thread, or when none runs it
+    void forgetConnection();
+
+    void startReceiving();
+    void stopReceiving();
+    void receiveFrames(unsigned generation);
+    void decodeMessages();
+
+    void connectionLost();
+    void scheduleReconnect();
+    void reconnect();
+    void cancelReconnect();
+
+    void startHeartBeats(unsigned generation, uint32_t send, uint32_t receive);
+    void sendHeartBeats(unsigned generation, uint32_t interval);
+    void checkLiveness(unsigned generation, uint32_t interval);
 
-    void receiveMessages();
+    // counts receipts older than the timeout as timed out, once each; they
+    // stay pending, so one that comes late is still handled
+    void checkReceipts(unsigned generation);
+    void expireReceipts();
     
-    void handleConnected(Frame f);
-    void handleReceipt(Frame f);
-    void handleMessage(Frame f);
+    void handleConnected(const Frame& f);
+    void handleReceipt(const Frame& f);
+    void handleMessage(const Frame& f);
 
-    static int generateReceiptID();
+    int generateReceiptID();
     size_t generateSubscriptionID(const std::string& topic);
 
 };
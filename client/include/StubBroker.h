@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include "Frame.h"
+
+
+// Routing core of the local stub broker: logins, subscriptions, receipts and
+// topic fan-out, following the rules of the course's Java server.
+// It never touches a socket; every client is a StubBroker::Session.
+// Not thread safe, drive it from a single thread.
+class StubBroker
+{
+public:
+    class Session
+    {
+    public:
+        virtual ~Session() = default;
+
+        // queues prefix followed by suffix (which may be null) for the client;
+        // together they hold whole frames, each ending with '\0'
+        virtual void deliver(std::string&& prefix, const std::shared_ptr<const std::string>& suffix) = 0;
+
+        // closes the connection once everything queued has been written
+        virtual void close() = 0;
+
+        // called when a CONNECT has agreed on heart-beat intervals, in ms
+        // (0: off); sessions without a clock may ignore it
+        virtual void heartBeat(uint32_t sendMs, uint32_t receiveMs) { (void)sendMs; (void)receiveMs; }
+    };
+
+    StubBroker();
+    StubBroker(const StubBroker&) = delete;
+    StubBroker& operator=(const StubBroker&) = delete;
+
+    void setHeartBeat(HeartBeat heartBeat); // offered in CONNECTED; 0,0 by default
+    void receive(Session& session, const Frame& frame);
+    void disconnected(Session& session);
+
+    uint64_t framesReceived() const;
+    uint64_t messagesDelivered() const;
+
+private:
+    struct Client
+    {
+        std::string user;
+        std::unordered_map<std::string, std::string> subscriptions; // id -> topic
+
+        Client() : user(), subscriptions() {}
+    };
+
+    struct Subscriber
+    {
+        Session* session;
+        std::string id;
+    };
+
+    std::unordered_map<Session*, Client> _clients;
+    std::unordered_map<std::string, std::vector<Subscriber>> _topics;
+    std::unordered_map<std::string, std::string> _passcodes;
+    std::unordered_map<std::string, Session*> _activeUsers;
+    HeartBeat _heartBeat;
+    uint64_t _nextMessageId;
+    uint64_t _framesReceived;
+    uint64_t _messagesDelivered;
+
+    void connect(Session& session, const Frame& frame);
+    void send(Session& session, Client& client, const Frame& frame);
+    void subscribe(Session& session, Client& client, const Frame& frame);
+    void unsubscribe(Session& session, Client& client, const Frame& frame);
+    void disconnect(Session& session, const Frame& frame);
+
+    void reply(Session& session, const Frame& frame);
+    void error(Session& session, const std::string& message);
+    void removeSubscription(Session& session, const std::string& topic, const std::string& id);
+
+    static std::string topicName(const std::string& destination);
+};
+
+// Serves a StubBroker over TCP on an io_context
+class StubBrokerServer
+{
+public:
+    StubBrokerServer(boost::asio::io_context& ioContext, StubBroker& broker, unsigned short port);
+    StubBrokerServer(const StubBrokerServer&) = delete;
+    StubBrokerServer& operator=(const StubBrokerServer&) = delete;
+
+    unsigned short port() const;
+
+private:
+    boost::asio::ip::tcp::acceptor _acceptor;
+    StubBroker& _broker;
+
+    void accept();
+};
+
+// Serves a StubBroker on a Unix domain socket, for clients on this host
+class StubBrokerUnixServer
+{
+public:
+    StubBrokerUnixServer(boost::asio::io_context& ioContext, StubBroker& broker, const std::string& path);
+    ~StubBrokerUnixServer();
+    StubBrokerUnixServer(const StubBrokerUnixServer&) = delete;
+    StubBrokerUnixServer& operator=(const StubBrokerUnixServer&) = delete;
+
+private:
+    boost::asio::local::stream_protocol::acceptor _acceptor;
+    StubBroker& _broker;
+    std::string _path;
+
+    void accept();
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "LockProfiler.h"
+#include "Probes.h"
+
+
+struct TraceStats
+{
+    uint64_t events;
+    uint64_t dropped; // lost because a thread's ring was full
+};
+
+// Opt-in timeline of client operations, written as Chrome trace-event JSON
+// (chrome://tracing, ui.perfetto.dev), one track per thread.
+// Every thread appends to a ring of its own without locking; a background
+// thread drains the rings into the file. Names and categories must outlive
+// the trace, string literals or the names Frame::getFrameName returns.
+// While no trace is running every call returns after one relaxed load.
+class Trace
+{
+public:
+    static void start(const std::string& path);
+    static TraceStats stop();
+    static bool enabled() { return _sEnabled.load(std::memory_order_relaxed); }
+
+    static int64_t now(); // monotonic ns
+    static void setThreadName(const char* name); // names this thread's track
+
+    static void complete(const char* category, const char* name, int64_t startNs, int64_t endNs);
+    // begin and end of an operation that spans threads, matched by category, name and id
+    static void asyncBegin(const char* category, const char* name, uint64_t id);
+    static void asyncEnd(const char* category, const char* name, uint64_t id);
+
+private:
+    static std::atomic<bool> _sEnabled;
+};
+
+// Traces the scope it lives in as one slice
+class TraceScope
+{
+public:
+    TraceScope(const char* category, const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* _category;
+    const char* _name;
+    int64_t _start; // 0 when no trace was running on entry
+};
+
+// Locks m and returns how long it waited for another thread to release it,
+// 0 when it did not have to. A mutex that times its own waits, like
+// ProfiledMutex, has an overload that reports those.
+template <typename Mutex>
+int64_t lockWaiting(Mutex& m)
+{
+    if (m.try_lock())
+        return 0;
+
+    int64_t start = Trace::now();
+    m.lock();
+    return Trace::now() - start;
+}
+
+// Holds m while it lives. A wait for another thread to release m is traced as
+// a "lock" slice, and the lock__acquired/lock__released probes fire around it.
+template <typename Mutex>
+class TracedLock
+{
+public:
+    TracedLock(Mutex& m, const char* name) : _mtx(m), _name(name)
+    {
+        int64_t start = Trace::enabled() ? Trace::now() : 0;
+        int64_t waited = lockWaiting(m);
+
+        if (waited > 0 && start != 0)
+            Trace::complete("lock", name, start, Trace::now());
+
+        STOMP_PROBE2(lock__acquired, _name, waited);
+    }
+
+    ~TracedLock()
+    {
+        _mtx.unlock();
+        STOMP_PROBE1(lock__released, _name);
+    }
+
+    TracedLock(const TracedLock&) = delete;
+    TracedLock& operator=(const TracedLock&) = delete;
+
+private:
+    Mutex& _mtx;
+    const char* _name;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+// traces the rest of the enclosing block
+#define TRACE_SCOPE(category, name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(category, name)
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <boost/asio.hpp>
+
+
+// The byte stream under a StompProtocol. Handlers run on the io_context the
+// transport was created with, never inside the call that starts them.
+//
+//   <host>:<port>   TCP
+//   uring:<host>:<port>
+//                   TCP through io_uring, where the build found liburing and
+//                   the kernel allows it; a plain socket otherwise
+//   unix:<path>     Unix domain socket, for a broker or relay on this host
+//   mem:<name>      in-process loopback to a stub broker of that name, which
+//                   the first client to connect creates; no kernel involved
+class Transport
+{
+public:
+    using ConnectHandler = std::function<void(const boost::system::error_code&)>;
+    using ReadHandler = std::function<void(const boost::system::error_code&, size_t)>;
+
+    static std::shared_ptr<Transport> create(boost::asio::io_context& ioContext, const std::string& address);
+
+    Transport() = default;
+    Transport(const Transport&) = delete;
+    Transport& operator=(const Transport&) = delete;
+    virtual ~Transport() = default;
+
+    virtual const std::string& address() const = 0;
+
+    virtual void connect(boost::system::error_code& ec) = 0;
+    virtual void asyncConnect(ConnectHandler handler) = 0;
+
+    // blocking; the caller serializes sends, the loop may be reading meanwhile
+    virtual void send(const boost::asio::const_buffer& data, boost::system::error_code& ec) = 0;
+
+    // appends to buffer until it holds delimiter, like asio::async_read_until
+    virtual void asyncReadUntil(boost::asio::streambuf& buffer, char delimiter, ReadHandler handler) = 0;
+
+    virtual void shutdown() = 0; // ends a pending read as if the peer had hung up
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+
+    // bytes written but not yet taken by the peer, 0 where unknown
+    virtual size_t outboundQueueBytes() const = 0;
+};
@@ -5,6 +5,56 @@
 #include <map>
 #include <unordered_map>
 #include <vector>
+#include <cstddef>
+
+
+// Characters owned by someone else, e.g. a range inside a frame body
+struct StringRef
+{
+    const char* data;
+    size_t length;
+
+    std::string str() const;
+};
+
+// Fields of an event frame body, pointing into the body they were parsed from.
+// Lets the body be decoded without copying any of it.
+struct EventFields
+{
+    StringRef user;
+    StringRef channel;
+    StringRef city;
+    StringRef name;
+    StringRef dateTime;
+    StringRef generalInfo; // the indented "key:value" lines
+    StringRef description;
+
+    static EventFields parse(const std::string& frameBody);
+    int datetime() const;
+
+    // calls f(key, value) with StringRefs for every general information line
+    template <typename F>
+    void forEachInfo(F f) const
+    {
+        const char* p = generalInfo.data;
+        const char* end = p + generalInfo.length;
+
+        while (p < end) {
+            const char* eol = p;
+            while (eol < end && *eol != '\n') ++eol;
+
+            const char* key = p + 1; // skip the indentation
+            const char* colon = key;
+            while (colon < eol && *colon != ':') ++colon;
+
+            if (colon < eol)
+                f(StringRef{key, static_cast<size_t>(colon - key)},
+                  StringRef{colon + 1, static_cast<size_t>(eol - colon - 1)});
+
+            p = eol + 1;
+        }
+    }
+};
 
 
 class Event
@@ -12,6 +62,7 @@ class Event
 public:
     Event(std::string channel_name, std::string city, std::string name, int date_time, std::string description, std::map<std::string, std::string> general_information);
     Event(const std::string & frame_body);
+    explicit Event(const EventFields& fields);
     void setEventOwnerUser(std::string setEventOwnerUser);
     void setChannelName(const std::string& channelName);
     const std::string &getEventOwnerUser() const;
@@ -36,6 +87,4 @@ private:
     std::map<std::string, std::string> _generalInfo; // map of all the general information
     std::string _eventOwner;
 
-    static std::unordered_map<std::string, std::string> parseFrameBody(const std::string& frameBody);
-    static std::map<std::string, std::string> parseGeneralInfo(const std::string& info);
 };
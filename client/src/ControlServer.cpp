@@ -0,0 +1,180 @@
+#include "ControlServer.h"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Log.h"
+#include "Parser.h"
+#include "StompProtocol.h"
+
+
+using boost::asio::local::stream_protocol;
+
+const char ControlServer::REPLY_END;
+
+namespace {
+
+// Sends std::cout and std::cerr to one buffer for as long as it lives
+class CaptureOutput
+{
+public:
+    explicit CaptureOutput(std::ostringstream& out)
+        : _cout(std::cout.rdbuf(out.rdbuf()))
+        , _cerr(std::cerr.rdbuf(out.rdbuf()))
+    {
+    }
+
+    ~CaptureOutput()
+    {
+        std::cout.rdbuf(_cout);
+        std::cerr.rdbuf(_cerr);
+    }
+
+    CaptureOutput(const CaptureOutput&) = delete;
+    CaptureOutput& operator=(const CaptureOutput&) = delete;
+
+private:
+    std::streambuf* _cout;
+    std::streambuf* _cerr;
+};
+
+// A daemon may have died without removing its socket; a live one still answers
+void removeStaleSocket(boost::asio::io_context& ioContext, const std::string& path)
+{
+    stream_protocol::socket probe(ioContext);
+    boost::system::error_code ec;
+    probe.connect(stream_protocol::endpoint(path), ec);
+
+    if (!ec)
+        throw std::runtime_error("A client daemon is already serving '" + path + '\'');
+
+    struct stat info;
+    if (::stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+        ::unlink(path.c_str());
+}
+
+}
+
+class ControlServer::Session : public std::enable_shared_from_this<Session>
+{
+public:
+    Session(ControlServer& server, stream_protocol::socket socket)
+        : _server(server)
+        , _socket(std::move(socket))
+        , _request()
+        , _output()
+        , _reply()
+    {
+    }
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    void readCommand()
+    {
+        std::shared_ptr<Session> self = shared_from_this();
+
+        boost::asio::async_read_until(_socket, _request, '\n',
+            [this, self](const boost::system::error_code& ec, size_t length) {
+                if (ec)
+                    return; // the front end is done
+
+                auto data = boost::asio::buffers_begin(_request.data());
+                std::string command(data, data + length - 1);
+                _request.consume(length);
+
+                _server.execute(command, _output, [this, self]() {
+                    _reply = _output.str();
+                    _reply.push_back(REPLY_END);
+                    _output.str(std::string());
+                    writeReply();
+                });
+            });
+    }
+
+private:
+    ControlServer& _server;
+    stream_protocol::socket _socket;
+    boost::asio::streambuf _request;
+    std::ostringstream _output; // the running command's, until it is done
+    std::string _reply;
+
+    void writeReply()
+    {
+        std::shared_ptr<Session> self = shared_from_this();
+
+        boost::asio::async_write(_socket, boost::asio::buffer(_reply),
+            [this, self](const boost::system::error_code& ec, size_t) {
+                if (Parser::shouldQuit()) {
+                    _server.stop();
+                    return;
+                }
+
+                if (!ec)
+                    readCommand();
+            });
+    }
+};
+
+ControlServer::ControlServer(StompProtocol& protocol, const std::string& path)
+    : _protocol(protocol)
+    , _path(path)
+    , _acceptor(protocol.ioContext())
+{
+    removeStaleSocket(protocol.ioContext(), path);
+
+    stream_protocol::endpoint endpoint(path);
+    _acceptor.open(endpoint.protocol());
+    _acceptor.bind(endpoint);
+    _acceptor.listen();
+}
+
+ControlServer::~ControlServer()
+{
+    boost::system::error_code ec;
+    _acceptor.close(ec);
+    ::unlink(_path.c_str());
+}
+
+void ControlServer::run()
+{
+    Log::info("Serving commands on '" + _path + '\'');
+    accept();
+    _protocol.ioContext().run();
+}
+
+void ControlServer::accept()
+{
+    _acceptor.async_accept([this](const boost::system::error_code& ec, stream_protocol::socket socket) {
+        if (ec)
+            return; // closed by stop()
+
+        std::make_shared<Session>(*this, std::move(socket))->readCommand();
+        accept();
+    });
+}
+
+void ControlServer::execute(const std::string& command, std::ostringstream& out, std::function<void()> done)
+{
+    if (Parser::isBusy()) {
+        Parser::whenDone([this, command, &out, done]() { execute(command, out, done); });
+        return;
+    }
+
+    {
+        CaptureOutput capture(out);
+        Parser::parseCommand(command, _protocol);
+    }
+
+    Parser::whenDone(std::move(done));
+}
+
+void ControlServer::stop()
+{
+    boost::system::error_code ec;
+    _acceptor.close(ec);
+    _protocol.ioContext().stop();
+}
@@ -0,0 +1,164 @@
+#include "DecoderPool.h"
+
+#include <cstring>
+
+#include "Frame.h"
+#include "Latency.h"
+#include "Trace.h"
+#include "Log.h"
+
+
+static Frame tracedParse(std::string&& rawFrame)
+{
+    TRACE_SCOPE("message", "parse");
+    return Frame::parseFrame(std::move(rawFrame));
+}
+
+DecoderPool::Worker::Worker(size_t capacity)
+    : queue(capacity)
+    , waiter()
+    , thread()
+    , submitted(0)
+    , handled(0)
+{
+}
+
+DecoderPool::DecoderPool(size_t workers, size_t queueCapacity, Handler handler)
+    : _workers()
+    , _handler(std::move(handler))
+    , _running(false)
+{
+    for (size_t i = 0; i < workers; ++i)
+        _workers.emplace_back(new Worker(queueCapacity));
+}
+
+DecoderPool::~DecoderPool()
+{
+    stop();
+}
+
+void DecoderPool::start()
+{
+    _running.store(true);
+
+    for (auto& worker : _workers)
+        worker->thread = std::thread(&DecoderPool::run, this, std::ref(*worker));
+}
+
+void DecoderPool::stop()
+{
+    _running.store(false);
+
+    for (auto& worker : _workers)
+        worker->waiter.notify();
+
+    for (auto& worker : _workers) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+}
+
+void DecoderPool::submit(std::string &&rawFrame)
+{
+    if (_workers.empty()) {
+        _handler(LATENCY_TIMED(FRAME_PARSE, Frame::parseFrame(std::move(rawFrame))));
+        return;
+    }
+
+    // FNV-1a over the destination picks the channel's worker
+    StringRef destination = messageDestination(rawFrame);
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < destination.length; ++i) {
+        hash ^= static_cast<unsigned char>(destination.data[i]);
+        hash *= 16777619u;
+    }
+
+    Worker& worker = *_workers[hash % _workers.size()];
+
+    worker.submitted.fetch_add(1, std::memory_order_relaxed);
+
+    while (!worker.queue.tryPush(std::move(rawFrame)))
+        std::this_thread::yield();
+
+    worker.waiter.notify();
+}
+
+size_t DecoderPool::size() const
+{
+    return _workers.size();
+}
+
+bool DecoderPool::idle() const
+{
+    for (const auto& worker : _workers) {
+        if (worker->handled.load(std::memory_order_acquire) != worker->submitted.load(std::memory_order_relaxed))
+            return false;
+    }
+
+    return true;
+}
+
+std::vector<QueueStats> DecoderPool::queueStats() const
+{
+    std::vector<QueueStats> stats;
+
+    for (const auto& worker : _workers)
+        stats.push_back(worker->queue.stats());
+
+    return stats;
+}
+
+StringRef DecoderPool::messageDestination(const std::string &rawFrame)
+{
+    static const char command[] = "MESSAGE\n";
+    static const char header[] = "destination:";
+    const size_t commandLength = sizeof(command) - 1;
+    const size_t headerLength = sizeof(header) - 1;
+
+    if (rawFrame.compare(0, commandLength, command) != 0)
+        return {nullptr, 0};
+
+    const char* p = rawFrame.data() + commandLength;
+    const char* end = rawFrame.data() + rawFrame.length();
+
+    while (p < end && *p != '\n') {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+
+        if (static_cast<size_t>(eol - p) >= headerLength && std::memcmp(p, header, headerLength) == 0)
+            return {p + headerLength, static_cast<size_t>(eol - p - headerLength)};
+
+        p = eol + 1;
+    }
+
+    return {nullptr, 0};
+}
+
+void DecoderPool::run(Worker &worker)
+{
+    std::string frame;
+    size_t idle = 0;
+    Trace::setThreadName("decode worker");
+
+    while (true) {
+        if (worker.queue.tryPop(frame)) {
+            idle = 0;
+
+            try {
+                TRACE_SCOPE("message", "MESSAGE");
+                _handler(LATENCY_TIMED(FRAME_PARSE, tracedParse(std::move(frame))));
+            } catch (std::exception& e) {
+                Log::error(e.what());
+            }
+
+            worker.handled.fetch_add(1, std::memory_order_release);
+            continue;
+        }
+
+        if (!_running.load() && worker.queue.empty())
+            break;
+
+        worker.waiter.backoff(++idle, [this, &worker]() { return !worker.queue.empty() || !_running.load(); });
+    }
+}
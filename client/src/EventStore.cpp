@@ -0,0 +1,212 @@
+#include "EventStore.h"
+
+#include <map>
+
+#include "Trace.h"
+
+
+static const size_t RECORD_BLOCK_SIZE = 8 * 1024;
+static const size_t STRING_BLOCK_SIZE = 32 * 1024;
+
+
+std::string SlabString::str() const
+{
+    return std::string(data, length);
+}
+
+double ChannelMemory::fragmentation() const
+{
+    return (reserved == 0) ? 0.0 : static_cast<double>(reserved - used) / reserved;
+}
+
+EventStore::EventStore()
+    : _channels()
+    , _mtxChannels("store channels")
+{
+}
+
+void EventStore::insert(const std::string &channelName, const Event &event)
+{
+    channel(channelName)->insert(event);
+}
+
+void EventStore::insert(const std::string &channelName, const EventFields &fields)
+{
+    channel(channelName)->insert(fields);
+}
+
+std::vector<Event> EventStore::reportsFrom(const std::string &channelName, const std::string &user) const
+{
+    std::shared_ptr<Channel> channel = findChannel(channelName);
+    return channel ? channel->reportsFrom(user) : std::vector<Event>();
+}
+
+std::vector<ChannelMemory> EventStore::memoryUsage() const
+{
+    std::vector<std::shared_ptr<Channel>> channels;
+
+    {
+        TracedLock<ProfiledMutex> lck(_mtxChannels, "store channels");
+        channels.reserve(_channels.size());
+        for (const auto& channel : _channels) channels.push_back(channel.second);
+    }
+
+    std::vector<ChannelMemory> usage;
+    usage.reserve(channels.size());
+
+    for (const auto& channel : channels)
+        usage.push_back(channel->memoryUsage());
+
+    return usage;
+}
+
+void EventStore::clear()
+{
+    TracedLock<ProfiledMutex> lck(_mtxChannels, "store channels");
+    _channels.clear();
+}
+
+std::shared_ptr<EventStore::Channel> EventStore::channel(const std::string &name)
+{
+    TracedLock<ProfiledMutex> lck(_mtxChannels, "store channels");
+    std::shared_ptr<Channel>& channel = _channels[name];
+
+    if (!channel)
+        channel = std::make_shared<Channel>(name);
+
+    return channel;
+}
+
+std::shared_ptr<EventStore::Channel> EventStore::findChannel(const std::string &name) const
+{
+    TracedLock<ProfiledMutex> lck(_mtxChannels, "store channels");
+    auto it = _channels.find(name);
+    return (it != _channels.end()) ? it->second : nullptr;
+}
+
+EventStore::Channel::Channel(const std::string &name)
+    : _name(name)
+    , _mtx("store channel")
+    , _records(RECORD_BLOCK_SIZE)
+    , _strings(STRING_BLOCK_SIZE)
+    , _count(0)
+    , _byOwner()
+{
+}
+
+void EventStore::Channel::insert(const Event &event)
+{
+    TracedLock<ProfiledMutex> lck(_mtx, "store channel");
+    const std::string& owner = event.getEventOwnerUser();
+    const std::map<std::string, std::string>& info = event.get_general_information();
+
+    EventRecord* record = newRecord(owner.data(), owner.length());
+    record->city = store(event.get_city());
+    record->name = store(event.get_name());
+    record->description = store(event.get_description());
+    record->datetime = event.get_date_time();
+    record->infoCount = static_cast<uint32_t>(info.size());
+
+    SlabString* field = _strings.allocate<SlabString>(info.size() * 2);
+    record->info = field;
+
+    for (const auto& entry : info) {
+        *field++ = store(entry.first);
+        *field++ = store(entry.second);
+    }
+}
+
+void EventStore::Channel::insert(const EventFields &fields)
+{
+    // decode straight from the frame body into the slabs
+    int datetime = fields.datetime();
+    uint32_t infoCount = 0;
+    fields.forEachInfo([&infoCount](StringRef, StringRef) { ++infoCount; });
+
+    TracedLock<ProfiledMutex> lck(_mtx, "store channel");
+
+    EventRecord* record = newRecord(fields.user.data, fields.user.length);
+    record->city = store(fields.city.data, fields.city.length);
+    record->name = store(fields.name.data, fields.name.length);
+    record->description = store(fields.description.data, fields.description.length);
+    record->datetime = datetime;
+    record->infoCount = infoCount;
+
+    SlabString* field = _strings.allocate<SlabString>(infoCount * 2);
+    record->info = field;
+
+    fields.forEachInfo([this, &field](StringRef key, StringRef value) {
+        *field++ = store(key.data, key.length);
+        *field++ = store(value.data, value.length);
+    });
+}
+
+std::vector<Event> EventStore::Channel::reportsFrom(const std::string &user) const
+{
+    TracedLock<ProfiledMutex> lck(_mtx, "store channel");
+    std::vector<Event> events;
+    auto it = _byOwner.find(user);
+
+    if (it == _byOwner.end())
+        return events;
+
+    events.reserve(it->second.size());
+
+    for (const EventRecord* record : it->second)
+        events.push_back(toEvent(*record));
+
+    return events;
+}
+
+ChannelMemory EventStore::Channel::memoryUsage() const
+{
+    TracedLock<ProfiledMutex> lck(_mtx, "store channel");
+    return {
+        _name,
+        _count,
+        _records.used() + _strings.used(),
+        _records.reserved() + _strings.reserved()
+    };
+}
+
+EventRecord* EventStore::Channel::newRecord(const char *owner, size_t ownerLength)
+{
+    std::vector<const EventRecord*>& owned = _byOwner[std::string(owner, ownerLength)];
+    EventRecord* record = _records.allocate<EventRecord>();
+
+    // every record of an owner shares one copy of the owner's name
+    record->owner = owned.empty() ? store(owner, ownerLength) : owned.front()->owner;
+    owned.push_back(record);
+    ++_count;
+    return record;
+}
+
+SlabString EventStore::Channel::store(const char *data, size_t length)
+{
+    return {_strings.copy(data, length), static_cast<uint32_t>(length)};
+}
+
+SlabString EventStore::Channel::store(const std::string &s)
+{
+    return store(s.data(), s.length());
+}
+
+Event EventStore::Channel::toEvent(const EventRecord &record) const
+{
+    std::map<std::string, std::string> info;
+
+    for (uint32_t i = 0; i < record.infoCount; ++i)
+        info.emplace_hint(info.end(), record.info[2 * i].str(), record.info[2 * i + 1].str());
+
+    Event event(
+        _name,
+        record.city.str(),
+        record.name.str(),
+        record.datetime,
+        record.description.str(),
+        info
+    );
+
+    event.setEventOwnerUser(record.owner.str());
+    return event;
+}
@@ -0,0 +1,267 @@
+#include "Frame.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+
+
+Frame::Frame(FrameType type, std::unordered_map<std::string, std::string> headers)
+    : Frame(type, std::move(headers), std::string())
+{
+}
+
+Frame::Frame(FrameType type, std::unordered_map<std::string, std::string> headers, std::string body)
+    : _type(type), _headers(std::move(headers)), _body(std::move(body))
+{
+}
+
+FrameType Frame::type() const
+{
+    return _type;
+}
+
+const std::string &Frame::getHeader(const std::string &header) const
+{
+    static const std::string none;
+    auto it = _headers.find(header);
+    return (it != _headers.end()) ? it->second : none;
+}
+
+const std::string &Frame::body() const
+{
+    return _body;
+}
+
+const std::unordered_map<std::string, std::string> &Frame::headers() const
+{
+    return _headers;
+}
+
+void Frame::setHeader(const std::string &header, std::string value)
+{
+    _headers[header] = std::move(value);
+}
+
+std::string Frame::raw() const
+{
+    const std::string& name = getFrameName(_type);
+    size_t length = name.length() + _body.length() + 3;
+
+    for (const auto& header : _headers)
+        length += header.first.length() + header.second.length() + 2;
+
+    std::string frame;
+    frame.reserve(length);
+    frame.append(name).append(1, '\n');
+
+    for (const auto& header : _headers)
+        frame.append(header.first).append(1, ':').append(header.second).append(1, '\n');
+
+    frame.append(1, '\n');
+    frame.append(_body);
+    frame.append(1, '\0');
+    
+    return frame;
+}
+
+Frame Frame::parseFrame(const std::string &frame)
+{
+    FrameType type;
+    std::unordered_map<std::string, std::string> headers;
+    size_t bodyPos = parseHead(frame, type, headers);
+    return Frame(type, std::move(headers), frame.substr(bodyPos));
+}
+
+Frame Frame::parseFrame(std::string &&frame)
+{
+    FrameType type;
+    std::unordered_map<std::string, std::string> headers;
+    size_t bodyPos = parseHead(frame, type, headers);
+
+    // the body is what is left of the frame's own buffer
+    frame.erase(0, bodyPos);
+    return Frame(type, std::move(headers), std::move(frame));
+}
+
+size_t Frame::parseHead(const std::string &frame, FrameType &type, std::unordered_map<std::string, std::string> &headers)
+{
+    size_t eol = frame.find('\n');
+    type = getFrameType(frame.substr(0, eol));
+
+    if (eol == std::string::npos)
+        return frame.length();
+
+    size_t pos = eol + 1;
+
+    while (pos < frame.length() && frame[pos] != '\n') {
+        eol = frame.find('\n', pos);
+        if (eol == std::string::npos) eol = frame.length();
+
+        size_t colonPos = frame.find(':', pos);
+        if (colonPos > eol) colonPos = eol;
+        size_t valuePos = std::min(colonPos + 1, eol);
+
+        headers[frame.substr(pos, colonPos - pos)] = frame.substr(valuePos, eol - valuePos);
+        pos = eol + 1;
+    }
+
+    return std::min(pos + 1, frame.length()); // skip the empty line
+}
+
+const std::string& Frame::getFrameName(FrameType t)
+{
+    static const std::string names[] = {
+        "CONNECT",
+        "SEND",
+        "SUBSCRIBE",
+        "UNSUBSCRIBE",
+        "DISCONNECT",
+        "CONNECTED",
+        "MESSAGE",
+        "RECEIPT",
+        "ERROR"
+    };
+
+    return names[static_cast<size_t>(t)];
+}
+
+FrameType Frame::getFrameType(const std::string &name)
+{
+    static const std::unordered_map<std::string, FrameType> types = {
+        {"CONNECT", FrameType::CONNECT},
+        {"SEND", FrameType::SEND},
+        {"SUBSCRIBE", FrameType::SUBSCRIBE},
+        {"UNSUBSCRIBE", FrameType::UNSUBSCRIBE},
+        {"DISCONNECT", FrameType::DISCONNECT},
+        {"CONNECTED", FrameType::CONNECTED},
+        {"MESSAGE", FrameType::MESSAGE},
+        {"RECEIPT", FrameType::RECEIPT},
+        {"ERROR", FrameType::ERROR}
+    };
+
+    auto it = types.find(name);
+
+    if (it == types.end())
+        throw std::invalid_argument('\'' + name + "' is not a frame type");
+
+    return it->second;
+}
+
+Frame Frame::Connect(const std::string &user, const std::string &password, HeartBeat heartBeat)
+{
+    std::unordered_map<std::string, std::string> headers = {
+        {"login", user},
+        {"passcode", password},
+        {"accept-version", "1.2"},
+        {"host", "stomp.cs.bgu.ac.il"}
+    };
+
+    if (heartBeat.send != 0 || heartBeat.receive != 0)
+        headers.emplace("heart-beat", heartBeat.toString());
+
+    return Frame(FrameType::CONNECT, std::move(headers));
+}
+
+Frame Frame::Disconnect(int receipt)
+{
+    return Frame(
+        FrameType::DISCONNECT,
+        {{"receipt", std::to_string(receipt)}}
+    );
+}
+
+Frame Frame::Subscribe(const std::string &topic, int id, int receipt)
+{
+    std::unordered_map<std::string, std::string> headers = {
+        {"destination", topic},
+        {"id", std::to_string(id)},
+        {"receipt", std::to_string(receipt)}
+    };
+
+    return Frame(FrameType::SUBSCRIBE, std::move(headers));
+}
+
+Frame Frame::Unsubscribe(int id, int receipt)
+{
+    return Frame(
+        FrameType::UNSUBSCRIBE,
+        {{"id", std::to_string(id)}, {"receipt", std::to_string(receipt)}}
+    );
+}
+
+Frame Frame::Send(const Event &event, int receipt)
+{
+    return Frame(
+        FrameType::SEND,
+        {{"receipt", std::to_string(receipt)}, {"destination", '/' + event.get_channel_name()}},
+        event.toString()
+    );
+}
+
+Frame Frame::Send(const Event &event)
+{
+    return Frame(
+        FrameType::SEND,
+        {{"destination", '/' + event.get_channel_name()}},
+        event.toString()
+    );
+}
+
+Frame Frame::Connected(const std::string &version, HeartBeat heartBeat)
+{
+    std::unordered_map<std::string, std::string> headers = {{"version", version}};
+
+    if (heartBeat.send != 0 || heartBeat.receive != 0)
+        headers.emplace("heart-beat", heartBeat.toString());
+
+    return Frame(FrameType::CONNECTED, std::move(headers));
+}
+
+Frame Frame::Receipt(const std::string &receiptId)
+{
+    return Frame(FrameType::RECEIPT, {{"receipt-id", receiptId}});
+}
+
+Frame Frame::Error(const std::string &message)
+{
+    return Frame(FrameType::ERROR, {{"message", message}});
+}
+
+std::string HeartBeat::toString() const
+{
+    return std::to_string(send) + ',' + std::to_string(receive);
+}
+
+// Digits only, as the header has them, and at most UINT32_MAX ms
+static bool parseInterval(const std::string& text, uint32_t& ms)
+{
+    if (text.empty() || text.length() > 10 || text.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+
+    unsigned long long value = std::stoull(text);
+    ms = static_cast<uint32_t>(value);
+    return value <= UINT32_MAX;
+}
+
+HeartBeat HeartBeat::parse(const std::string &header)
+{
+    HeartBeat heartBeat = {0, 0};
+
+    if (header.empty())
+        return heartBeat;
+
+    size_t comma = header.find(',');
+
+    if (comma == std::string::npos || !parseInterval(header.substr(0, comma), heartBeat.send)
+            || !parseInterval(header.substr(comma + 1), heartBeat.receive)) {
+        throw std::invalid_argument("Invalid heart-beat header: '" + header + '\'');
+    }
+
+    return heartBeat;
+}
+
+uint32_t HeartBeat::interval(uint32_t senderSend, uint32_t receiverReceive)
+{
+    return (senderSend == 0 || receiverReceive == 0) ? 0 : std::max(senderSend, receiverReceive);
+}
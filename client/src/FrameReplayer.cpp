@@ -0,0 +1,122 @@
+#include "FrameReplayer.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <boost/asio.hpp>
+
+#include "StompProtocol.h"
+
+
+using Clock = std::chrono::steady_clock;
+
+static const double DRAIN_TIMEOUT_SECONDS = 10;
+
+FrameReplayer::FrameReplayer(StompProtocol &protocol)
+    : _protocol(protocol)
+{
+}
+
+ReplayResult FrameReplayer::replay(const std::vector<TimedFrame> &frames, double speed,
+                                   const std::string &user, const std::string &passcode)
+{
+    ReplayResult result = {frames.size(), 0, 0, 0, false};
+    size_t expected = 0;
+
+    for (const TimedFrame& frame : frames) {
+        result.bytes += frame.bytes.length();
+        if (isMessage(frame.bytes)) ++expected;
+    }
+
+    if (_protocol.isLoggedIn())
+        throw std::logic_error("Already logged in");
+
+    // shared with the listener, which decode threads may still be running after replay() returns
+    struct Progress
+    {
+        std::atomic<size_t> handled;
+        std::atomic<Clock::rep> lastHandled;
+    };
+
+    std::shared_ptr<Progress> progress = std::make_shared<Progress>();
+    progress->handled.store(0);
+    progress->lastHandled.store(0);
+
+    _protocol.setMessageListener([progress](const Frame&) {
+        progress->lastHandled.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        progress->handled.fetch_add(1, std::memory_order_release);
+        return false;
+    });
+
+    boost::asio::io_context ioContext;
+    boost::asio::ip::tcp::acceptor acceptor(
+        ioContext, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    boost::asio::ip::tcp::socket socket(ioContext);
+
+    std::atomic<bool> clientDone(false);
+    Clock::time_point start;
+    double playSeconds = frames.empty() ? 0 : frames.back().time - frames.front().time;
+
+    std::thread server([&]() {
+        boost::system::error_code ec;
+        acceptor.accept(socket, ec);
+
+        if (ec)
+            return;
+
+        socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+        start = Clock::now();
+
+        if (speed <= 0) {
+            std::vector<boost::asio::const_buffer> buffers;
+            for (const TimedFrame& frame : frames) buffers.push_back(boost::asio::buffer(frame.bytes));
+            boost::asio::write(socket, buffers, ec);
+        } else {
+            for (const TimedFrame& frame : frames) {
+                double offset = (frame.time - frames.front().time) / speed;
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(offset)));
+
+                boost::asio::write(socket, boost::asio::buffer(frame.bytes), ec);
+
+                if (ec)
+                    break;
+            }
+        }
+
+        // keep the connection up until the client went away
+        while (!clientDone.load())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        socket.close(ec);
+    });
+
+    _protocol.login("127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()), user, passcode);
+
+    double timeout = (speed > 0 ? playSeconds / speed : 0) + DRAIN_TIMEOUT_SECONDS;
+    Clock::time_point deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout));
+
+    while (progress->handled.load(std::memory_order_acquire) < expected && Clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+    result.messages = progress->handled.load();
+    result.complete = (result.messages == expected);
+
+    _protocol.closeConnection();
+    clientDone.store(true);
+    server.join();
+
+    if (result.messages > 0) {
+        Clock::time_point last{Clock::duration(progress->lastHandled.load())};
+        result.seconds = std::chrono::duration<double>(last - start).count();
+    }
+
+    return result;
+}
+
+bool FrameReplayer::isMessage(const std::string &rawFrame)
+{
+    size_t start = rawFrame.find_first_not_of("\r\n");
+    return start != std::string::npos && rawFrame.compare(start, 8, "MESSAGE\n") == 0;
+}
@@ -0,0 +1,153 @@
+#include "Histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+
+
+Histogram::Histogram()
+    : _counts(bucketOf(std::numeric_limits<uint64_t>::max()) + 1, 0)
+    , _count(0)
+    , _min(std::numeric_limits<uint64_t>::max())
+    , _max(0)
+    , _sum(0)
+{
+}
+
+void Histogram::record(uint64_t value)
+{
+    ++_counts[bucketOf(value)];
+    ++_count;
+    _sum += static_cast<double>(value);
+    if (value < _min) _min = value;
+    if (value > _max) _max = value;
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    for (size_t i = 0; i < _counts.size(); ++i)
+        _counts[i] += other._counts[i];
+
+    _count += other._count;
+    _sum += other._sum;
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+}
+
+void Histogram::reset()
+{
+    std::fill(_counts.begin(), _counts.end(), 0);
+    _count = 0;
+    _sum = 0;
+    _min = std::numeric_limits<uint64_t>::max();
+    _max = 0;
+}
+
+uint64_t Histogram::count() const
+{
+    return _count;
+}
+
+uint64_t Histogram::min() const
+{
+    return (_count == 0) ? 0 : _min;
+}
+
+uint64_t Histogram::max() const
+{
+    return _max;
+}
+
+double Histogram::mean() const
+{
+    return (_count == 0) ? 0 : _sum / _count;
+}
+
+uint64_t Histogram::percentile(double percent) const
+{
+    if (_count == 0)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(percent / 100.0 * _count));
+    rank = std::max<uint64_t>(1, std::min(rank, _count));
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < _counts.size(); ++i) {
+        seen += _counts[i];
+
+        if (seen >= rank)
+            return std::min(highestValueIn(i), _max);
+    }
+
+    return _max;
+}
+
+void Histogram::printSummary(std::ostream &out, double unitScale, const std::string &unit) const
+{
+    out << std::fixed << std::setprecision(1)
+        << "p50 " << percentile(50) / unitScale << unit
+        << "  p99 " << percentile(99) / unitScale << unit
+        << "  p99.9 " << percentile(99.9) / unitScale << unit
+        << "  max " << max() / unitScale << unit
+        << "  (n=" << count() << ")\n";
+}
+
+void Histogram::printDistribution(std::ostream &out, double unitScale, const std::string &unit) const
+{
+    out << std::right << std::setw(14) << ("Value (" + unit + ")")
+        << std::setw(14) << "Percentile"
+        << std::setw(14) << "TotalCount" << '\n';
+
+    if (_count == 0)
+        return;
+
+    // halve the remaining tail at every step: 50, 75, 87.5, 93.75...
+    double tail = 50.0;
+    double percent = 0.0;
+
+    while (true) {
+        uint64_t value = percentile(percent);
+        uint64_t rank = static_cast<uint64_t>(std::ceil(percent / 100.0 * _count));
+
+        out << std::fixed << std::setprecision(3)
+            << std::setw(14) << value / unitScale
+            << std::setw(14) << std::setprecision(6) << percent / 100.0
+            << std::setw(14) << std::max<uint64_t>(rank, 1) << '\n';
+
+        if (rank >= _count || tail < 1e-7)
+            break;
+
+        percent = 100.0 - tail;
+        tail /= 2;
+    }
+
+    out << std::fixed << std::setprecision(3)
+        << std::setw(14) << max() / unitScale
+        << std::setw(14) << std::setprecision(6) << 1.0
+        << std::setw(14) << _count << '\n'
+        << std::setprecision(3) << "#[Mean = " << mean() / unitScale << ", Max = " << max() / unitScale
+        << ", Total count = " << _count << "]\n";
+}
+
+size_t Histogram::bucketOf(uint64_t value)
+{
+    // values below 2 * SUB_BUCKETS map one to one; above, each power of two
+    // gets SUB_BUCKETS buckets of equal width
+    unsigned magnitude = 0;
+    uint64_t v = value >> SUB_BUCKET_BITS;
+
+    while (v > 1) {
+        v >>= 1;
+        ++magnitude;
+    }
+
+    return static_cast<size_t>(magnitude * SUB_BUCKETS + (value >> magnitude));
+}
+
+uint64_t Histogram::highestValueIn(size_t bucket)
+{
+    unsigned magnitude = (bucket < 2 * SUB_BUCKETS) ? 0 : static_cast<unsigned>(bucket / SUB_BUCKETS - 1);
+    uint64_t sub = bucket - magnitude * SUB_BUCKETS;
+    return ((sub + 1) << magnitude) - 1;
+}
@@ -0,0 +1,161 @@
+#include "Latency.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+
+namespace {
+
+struct Slot
+{
+    std::atomic_flag busy;
+    std::vector<std::unique_ptr<Histogram>> histograms; // made on first use, most threads time few spans
+    bool inUse;
+
+    Slot() : busy(), histograms(static_cast<size_t>(LatencySpan::COUNT)), inUse(true)
+    {
+        busy.clear();
+    }
+
+    void lock()
+    {
+        while (busy.test_and_set(std::memory_order_acquire)) {}
+    }
+
+    void unlock()
+    {
+        busy.clear(std::memory_order_release);
+    }
+};
+
+// Slots outlive their threads, so what exited threads measured stays in
+// the totals; a new thread takes over a free slot before making one.
+class Registry
+{
+public:
+    Registry() : _slots(), _mtx() {}
+
+    Slot* acquire()
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+
+        for (auto& slot : _slots) {
+            if (!slot->inUse) {
+                slot->inUse = true;
+                return slot.get();
+            }
+        }
+
+        _slots.emplace_back(new Slot());
+        return _slots.back().get();
+    }
+
+    void release(Slot* slot)
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        slot->inUse = false;
+    }
+
+    template <typename F>
+    void forEach(F f)
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+
+        for (auto& slot : _slots) {
+            slot->lock();
+            f(*slot);
+            slot->unlock();
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<Slot>> _slots;
+    std::mutex _mtx;
+};
+
+Registry& registry()
+{
+    static Registry* instance = new Registry(); // never destroyed: threads may record during exit
+    return *instance;
+}
+
+struct ThreadSlot
+{
+    Slot* slot;
+
+    ThreadSlot() : slot(registry().acquire()) {}
+    ~ThreadSlot() { registry().release(slot); }
+
+    ThreadSlot(const ThreadSlot&) = delete;
+    ThreadSlot& operator=(const ThreadSlot&) = delete;
+};
+
+}
+
+const char* Latency::name(LatencySpan span)
+{
+    static const char* names[] = {
+        "socket read", "frame parse", "event decode", "store insert",
+        "frame encode", "socket write", "receipt round-trip"
+    };
+
+    return names[static_cast<size_t>(span)];
+}
+
+bool Latency::enabled()
+{
+#ifndef STOMP_NO_LATENCY
+    return true;
+#else
+    return false;
+#endif
+}
+
+int64_t Latency::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Latency::record(LatencySpan span, int64_t ns)
+{
+    thread_local ThreadSlot local;
+    Slot& slot = *local.slot;
+
+    std::unique_ptr<Histogram>& histogram = slot.histograms[static_cast<size_t>(span)];
+
+    if (!histogram) {
+        std::unique_ptr<Histogram> created(new Histogram());
+        slot.lock();
+        histogram = std::move(created);
+        slot.unlock();
+    }
+
+    slot.lock();
+    histogram->record(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+    slot.unlock();
+}
+
+std::vector<Histogram> Latency::snapshot()
+{
+    std::vector<Histogram> merged(static_cast<size_t>(LatencySpan::COUNT));
+
+    registry().forEach([&merged](Slot& slot) {
+        for (size_t i = 0; i < merged.size(); ++i) {
+            if (slot.histograms[i]) merged[i].merge(*slot.histograms[i]);
+        }
+    });
+
+    return merged;
+}
+
+void Latency::reset()
+{
+    registry().forEach([](Slot& slot) {
+        for (auto& histogram : slot.histograms) {
+            if (histogram) histogram->reset();
+        }
+    });
+}
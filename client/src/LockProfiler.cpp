@@ -0,0 +1,312 @@
+#include "LockProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+
+
+std::atomic<bool> LockProfiler::_sEnabled(false);
+
+static int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+
+class Sites
+{
+public:
+    Sites() : _sites(), _mtx() {}
+
+    LockSite& find(const char* name)
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+
+        for (auto& site : _sites) {
+            if (std::strcmp(site.first, name) == 0)
+                return *site.second;
+        }
+
+        _sites.emplace_back(name, std::unique_ptr<LockSite>(new LockSite(name, _sites.size())));
+        return *_sites.back().second;
+    }
+
+    template <typename F>
+    void forEach(F f)
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+
+        for (auto& site : _sites)
+            f(*site.second);
+    }
+
+private:
+    std::vector<std::pair<const char*, std::unique_ptr<LockSite>>> _sites;
+    std::mutex _mtx;
+};
+
+Sites& sites()
+{
+    static Sites* instance = new Sites(); // never destroyed: mutexes may outlive static destruction
+    return *instance;
+}
+
+// One thread's counts for one site
+struct SiteRecord
+{
+    uint64_t acquisitions;
+    uint64_t contended;
+    uint64_t totalWaitNs;
+    uint64_t maxWaitNs;
+    Histogram holdNs;
+
+    SiteRecord() : acquisitions(0), contended(0), totalWaitNs(0), maxWaitNs(0), holdNs() {}
+};
+
+// A thread's records, by site index. Its spin lock is only ever contended by
+// a snapshot or a reset copying them.
+struct Slot
+{
+    std::atomic_flag busy;
+    std::vector<std::unique_ptr<SiteRecord>> sites; // made on first use
+    bool inUse;
+
+    Slot() : busy(), sites(), inUse(true)
+    {
+        busy.clear();
+    }
+
+    void lock()
+    {
+        while (busy.test_and_set(std::memory_order_acquire)) {}
+    }
+
+    void unlock()
+    {
+        busy.clear(std::memory_order_release);
+    }
+};
+
+// Slots outlive their threads, so what exited threads measured stays in
+// the totals; a new thread takes over a free slot before making one.
+class Slots
+{
+public:
+    Slots() : _slots(), _mtx() {}
+
+    Slot* acquire()
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+
+        for (auto& slot : _slots) {
+            if (!slot->inUse) {
+                slot->inUse = true;
+                return slot.get();
+            }
+        }
+
+        _slots.emplace_back(new Slot());
+        return _slots.back().get();
+    }
+
+    void release(Slot* slot)
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        slot->inUse = false;
+    }
+
+    // f gets each thread's record of the site, if it has one
+    template <typename F>
+    void forEach(size_t index, F f)
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+
+        for (auto& slot : _slots) {
+            slot->lock();
+            if (index < slot->sites.size() && slot->sites[index])
+                f(*slot->sites[index]);
+            slot->unlock();
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<Slot>> _slots;
+    std::mutex _mtx;
+};
+
+Slots& slots()
+{
+    static Slots* instance = new Slots(); // never destroyed: threads may take locks during exit
+    return *instance;
+}
+
+struct ThreadSlot
+{
+    Slot* slot;
+
+    ThreadSlot() : slot(slots().acquire()) {}
+    ~ThreadSlot() { slots().release(slot); }
+
+    ThreadSlot(const ThreadSlot&) = delete;
+    ThreadSlot& operator=(const ThreadSlot&) = delete;
+};
+
+// Runs f on this thread's record of the site
+template <typename F>
+void updateLocal(size_t index, F f)
+{
+    thread_local ThreadSlot local;
+    Slot& slot = *local.slot;
+
+    if (index >= slot.sites.size() || !slot.sites[index]) {
+        std::unique_ptr<SiteRecord> created(new SiteRecord());
+        slot.lock();
+        if (index >= slot.sites.size()) slot.sites.resize(index + 1);
+        slot.sites[index] = std::move(created);
+        slot.unlock();
+    }
+
+    slot.lock();
+    f(*slot.sites[index]);
+    slot.unlock();
+}
+
+}
+
+LockSite::LockSite(const char *name, size_t index)
+    : _name(name)
+    , _index(index)
+{
+}
+
+void LockSite::acquired(int64_t waitNs)
+{
+    updateLocal(_index, [waitNs](SiteRecord& record) {
+        ++record.acquisitions;
+
+        if (waitNs <= 0)
+            return;
+
+        uint64_t wait = static_cast<uint64_t>(waitNs);
+        ++record.contended;
+        record.totalWaitNs += wait;
+        record.maxWaitNs = std::max(record.maxWaitNs, wait);
+    });
+}
+
+void LockSite::released(int64_t holdNs)
+{
+    updateLocal(_index, [holdNs](SiteRecord& record) {
+        record.holdNs.record(holdNs > 0 ? static_cast<uint64_t>(holdNs) : 0);
+    });
+}
+
+LockStats LockSite::stats()
+{
+    LockStats stats;
+    stats.site = _name;
+
+    slots().forEach(_index, [&stats](const SiteRecord& record) {
+        stats.acquisitions += record.acquisitions;
+        stats.contended += record.contended;
+        stats.totalWaitNs += record.totalWaitNs;
+        stats.maxWaitNs = std::max(stats.maxWaitNs, record.maxWaitNs);
+        stats.holdNs.merge(record.holdNs);
+    });
+
+    return stats;
+}
+
+void LockSite::reset()
+{
+    slots().forEach(_index, [](SiteRecord& record) { record = SiteRecord(); });
+}
+
+void LockProfiler::enable(bool on)
+{
+    _sEnabled.store(on);
+}
+
+LockSite& LockProfiler::site(const char *name)
+{
+    return sites().find(name);
+}
+
+std::vector<LockStats> LockProfiler::snapshot()
+{
+    std::vector<LockStats> stats;
+    sites().forEach([&stats](LockSite& site) { stats.push_back(site.stats()); });
+    return stats;
+}
+
+void LockProfiler::reset()
+{
+    sites().forEach([](LockSite& site) { site.reset(); });
+}
+
+ProfiledMutex::ProfiledMutex(const char *site)
+    : _mtx()
+    , _site(LockProfiler::site(site))
+    , _acquiredAt(0)
+{
+}
+
+void ProfiledMutex::lock()
+{
+    if (!LockProfiler::enabled()) {
+        _mtx.lock();
+        _acquiredAt = 0;
+        return;
+    }
+
+    lockWaiting();
+}
+
+int64_t ProfiledMutex::lockWaiting()
+{
+    int64_t waited = 0;
+
+    if (!_mtx.try_lock()) {
+        int64_t start = nowNs();
+        _mtx.lock();
+        waited = nowNs() - start;
+    }
+
+    if (LockProfiler::enabled()) {
+        _acquiredAt = nowNs();
+        _site.acquired(waited);
+    } else {
+        _acquiredAt = 0;
+    }
+
+    return waited;
+}
+
+bool ProfiledMutex::try_lock()
+{
+    if (!_mtx.try_lock())
+        return false;
+
+    if (LockProfiler::enabled()) {
+        _acquiredAt = nowNs();
+        _site.acquired(0);
+    } else {
+        _acquiredAt = 0;
+    }
+
+    return true;
+}
+
+void ProfiledMutex::unlock()
+{
+    int64_t acquiredAt = _acquiredAt;
+    int64_t released = acquiredAt ? nowNs() : 0;
+
+    _mtx.unlock();
+
+    if (acquiredAt)
+        _site.released(released - acquiredAt);
+}
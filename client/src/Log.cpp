@@ -0,0 +1,218 @@
+#include "Log.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+
+#include "MpscQueue.h"
+
+
+static const size_t LOG_QUEUE_CAPACITY = 4096;
+static const char* LEVEL_NAMES[] = {"debug", "info", "warn", "error", "off"};
+
+namespace {
+
+struct LogLine
+{
+    LogLevel level;
+    std::string text;
+
+    LogLine() : level(LogLevel::INFO), text() {}
+    LogLine(LogLevel l, std::string t) : level(l), text(std::move(t)) {}
+};
+
+class Logger
+{
+public:
+    Logger()
+        : _queue(LOG_QUEUE_CAPACITY)
+        , _waiter()
+        , _flushWaiter()
+        , _level(LogLevel::INFO)
+        , _overflow(LogOverflow::DROP)
+        , _queued(0)
+        , _written(0)
+        , _dropped(0)
+        , _thread()
+    {
+        _thread = std::thread(&Logger::run, this);
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    void write(LogLevel level, std::string text)
+    {
+        if (level < _level.load(std::memory_order_relaxed))
+            return;
+
+        LogLine line(level, std::move(text));
+
+        while (!_queue.tryPush(std::move(line))) {
+            if (_overflow.load(std::memory_order_relaxed) == LogOverflow::DROP) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            std::this_thread::yield();
+        }
+
+        _queued.fetch_add(1, std::memory_order_release);
+        _waiter.notify();
+    }
+
+    void flush()
+    {
+        uint64_t target = _queued.load(std::memory_order_acquire);
+        size_t idle = 0;
+        auto written = [this, target]() { return _written.load(std::memory_order_acquire) >= target; };
+
+        while (!written())
+            _flushWaiter.backoff(++idle, written);
+    }
+
+    LogStats stats() const
+    {
+        return {_written.load(), _dropped.load(), _queue.stats()};
+    }
+
+    void setLevel(LogLevel level) { _level.store(level); }
+    LogLevel level() const { return _level.load(); }
+    void setOverflow(LogOverflow overflow) { _overflow.store(overflow); }
+    LogOverflow overflow() const { return _overflow.load(); }
+
+private:
+    MpscQueue<LogLine> _queue;
+    QueueWaiter _waiter;      // the writer thread's, woken by every line
+    QueueWaiter _flushWaiter; // flush()'s, woken by every line written
+    std::atomic<LogLevel> _level;
+    std::atomic<LogOverflow> _overflow;
+    std::atomic<uint64_t> _queued;
+    std::atomic<uint64_t> _written;
+    std::atomic<uint64_t> _dropped;
+    std::thread _thread;
+
+    void run()
+    {
+        LogLine line;
+        uint64_t droppedReported = 0;
+        size_t idle = 0;
+
+        while (true) {
+            if (_queue.tryPop(line)) {
+                idle = 0;
+
+                // stdio rather than the iostreams, which a caller may redirect for one command
+                std::FILE* out = (line.level >= LogLevel::WARN) ? stderr : stdout;
+                std::fputs(line.text.c_str(), out);
+                std::fputc('\n', out);
+                _written.fetch_add(1, std::memory_order_release);
+                _flushWaiter.notify();
+                continue;
+            }
+
+            // the queue is empty: a good moment to flush and to own up to losses
+            std::fflush(stdout);
+
+            uint64_t dropped = _dropped.load(std::memory_order_relaxed);
+            if (dropped != droppedReported) {
+                std::fprintf(stderr, "[log] %llu lines dropped, the log queue was full\n",
+                             static_cast<unsigned long long>(dropped - droppedReported));
+                droppedReported = dropped;
+            }
+
+            _waiter.backoff(++idle, [this]() { return !_queue.empty(); });
+        }
+    }
+};
+
+void flushAtExit()
+{
+    Log::flush();
+}
+
+// never destroyed: network threads may still log while the process exits
+Logger& logger()
+{
+    static Logger* instance = []() {
+        Logger* l = new Logger();
+        std::atexit(flushAtExit);
+        return l;
+    }();
+
+    return *instance;
+}
+
+}
+
+void Log::debug(std::string line)
+{
+    logger().write(LogLevel::DEBUG, std::move(line));
+}
+
+void Log::info(std::string line)
+{
+    logger().write(LogLevel::INFO, std::move(line));
+}
+
+void Log::warn(std::string line)
+{
+    logger().write(LogLevel::WARN, std::move(line));
+}
+
+void Log::error(std::string line)
+{
+    logger().write(LogLevel::ERROR, std::move(line));
+}
+
+void Log::write(LogLevel level, std::string line)
+{
+    logger().write(level, std::move(line));
+}
+
+void Log::setLevel(LogLevel level)
+{
+    logger().setLevel(level);
+}
+
+LogLevel Log::level()
+{
+    return logger().level();
+}
+
+void Log::setOverflow(LogOverflow overflow)
+{
+    logger().setOverflow(overflow);
+}
+
+LogOverflow Log::overflow()
+{
+    return logger().overflow();
+}
+
+void Log::flush()
+{
+    logger().flush();
+}
+
+LogStats Log::stats()
+{
+    return logger().stats();
+}
+
+LogLevel Log::parseLevel(const std::string &name)
+{
+    for (size_t i = 0; i < sizeof(LEVEL_NAMES) / sizeof(*LEVEL_NAMES); ++i) {
+        if (name == LEVEL_NAMES[i])
+            return static_cast<LogLevel>(i);
+    }
+
+    throw std::invalid_argument("Unknown log level: '" + name + '\'');
+}
+
+const char* Log::levelName(LogLevel level)
+{
+    return LEVEL_NAMES[static_cast<size_t>(level)];
+}
@@ -0,0 +1,251 @@
+#include "Metrics.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "StompProtocol.h"
+
+
+ClientMetrics::ClientMetrics()
+    : framesIn()
+    , framesOut()
+    , bytesIn(0)
+    , bytesOut(0)
+    , connects(0)
+    , reconnects(0)
+    , outageNs(0)
+    , lastOutageNs(0)
+    , receiptTimeouts(0)
+    , heartBeatTimeouts(0)
+{
+    for (size_t i = 0; i < FRAME_TYPES; ++i) {
+        framesIn[i].store(0);
+        framesOut[i].store(0);
+    }
+}
+
+static std::string labelValue(const std::string& value)
+{
+    std::string escaped;
+
+    for (char c : value) {
+        if (c == '\\' || c == '"') escaped += '\\';
+        if (c == '\n') escaped += "\\n";
+        else escaped += c;
+    }
+
+    return escaped;
+}
+
+static void family(std::ostream& out, const char* name, const char* type, const char* help)
+{
+    out << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << ' ' << type << '\n';
+}
+
+MetricsExporter::MetricsExporter(StompProtocol &protocol)
+    : _protocol(protocol)
+    , _ioContext()
+    , _work(boost::asio::make_work_guard(_ioContext))
+    , _thread()
+    , _timer()
+    , _path()
+    , _intervalSeconds(0)
+    , _acceptor()
+{
+    _thread = std::thread(&MetricsExporter::run, this);
+}
+
+MetricsExporter::~MetricsExporter()
+{
+    _ioContext.stop();
+    _thread.join();
+}
+
+void MetricsExporter::writeFile(const std::string &path, double intervalSeconds)
+{
+    if (_timer)
+        throw std::logic_error("Already writing metrics to '" + _path + '\'');
+
+    _path = path;
+    _intervalSeconds = intervalSeconds;
+    _timer.reset(new boost::asio::steady_timer(_ioContext));
+
+    boost::asio::post(_ioContext, [this]() {
+        writeNow();
+        scheduleWrite();
+    });
+}
+
+unsigned short MetricsExporter::serveHttp(unsigned short port)
+{
+    if (_acceptor)
+        return _acceptor->local_endpoint().port();
+
+    // bound here so a port in use is reported to the caller
+    std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor(new boost::asio::ip::tcp::acceptor(
+        _ioContext, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port)));
+    unsigned short bound = acceptor->local_endpoint().port();
+
+    _acceptor = std::move(acceptor);
+    boost::asio::post(_ioContext, [this]() { accept(); });
+
+    return bound;
+}
+
+std::string MetricsExporter::describe() const
+{
+    std::ostringstream out;
+
+    if (!_path.empty())
+        out << "writing '" << _path << "' every " << _intervalSeconds << " s";
+
+    if (_acceptor)
+        out << (_path.empty() ? "" : ", ") << "serving http://127.0.0.1:" << _acceptor->local_endpoint().port() << "/metrics";
+
+    return out.str();
+}
+
+void MetricsExporter::run()
+{
+    _ioContext.run();
+}
+
+void MetricsExporter::scheduleWrite()
+{
+    _timer->expires_after(std::chrono::milliseconds(static_cast<long>(_intervalSeconds * 1000)));
+    _timer->async_wait([this](const boost::system::error_code& ec) {
+        if (ec)
+            return;
+
+        writeNow();
+        scheduleWrite();
+    });
+}
+
+// written next to the target and renamed over it, so scrapers never see half a file
+void MetricsExporter::writeNow()
+{
+    std::string temporary = _path + ".tmp";
+
+    {
+        std::ofstream f(temporary);
+        f << render(_protocol);
+
+        if (!f)
+            return;
+    }
+
+    std::rename(temporary.c_str(), _path.c_str());
+}
+
+void MetricsExporter::accept()
+{
+    _acceptor->async_accept([this](const boost::system::error_code& ec, boost::asio::ip::tcp::socket socket) {
+        if (ec)
+            return;
+
+        // every request gets the metrics, whatever its path; the request
+        // itself is read so closing does not reset the connection
+        auto client = std::make_shared<boost::asio::ip::tcp::socket>(std::move(socket));
+        auto request = std::make_shared<boost::asio::streambuf>();
+
+        boost::asio::async_read_until(*client, *request, "\r\n\r\n",
+            [this, client, request](const boost::system::error_code& ec, size_t) {
+                if (ec)
+                    return;
+
+                std::string body = render(_protocol);
+                auto response = std::make_shared<std::string>(
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: " + std::to_string(body.length()) + "\r\n"
+                    "Connection: close\r\n\r\n" + body);
+
+                boost::asio::async_write(*client, boost::asio::buffer(*response),
+                    [client, response](const boost::system::error_code&, size_t) {
+                        boost::system::error_code ignored;
+                        client->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+                    });
+            });
+
+        accept();
+    });
+}
+
+std::string MetricsExporter::render(StompProtocol &protocol)
+{
+    const ClientMetrics& metrics = protocol.getMetrics();
+    std::ostringstream out;
+
+    family(out, "stomp_client_frames_received_total", "counter", "Frames received from the broker, by command.");
+    for (size_t i = 0; i < ClientMetrics::FRAME_TYPES; ++i) {
+        out << "stomp_client_frames_received_total{command=\"" << Frame::getFrameName(static_cast<FrameType>(i))
+            << "\"} " << metrics.framesIn[i].load(std::memory_order_relaxed) << '\n';
+    }
+
+    family(out, "stomp_client_frames_sent_total", "counter", "Frames sent to the broker, by command.");
+    for (size_t i = 0; i < ClientMetrics::FRAME_TYPES; ++i) {
+        out << "stomp_client_frames_sent_total{command=\"" << Frame::getFrameName(static_cast<FrameType>(i))
+            << "\"} " << metrics.framesOut[i].load(std::memory_order_relaxed) << '\n';
+    }
+
+    family(out, "stomp_client_received_bytes_total", "counter", "Bytes of frames received from the broker.");
+    out << "stomp_client_received_bytes_total " << metrics.bytesIn.load(std::memory_order_relaxed) << '\n';
+
+    family(out, "stomp_client_sent_bytes_total", "counter", "Bytes of frames sent to the broker.");
+    out << "stomp_client_sent_bytes_total " << metrics.bytesOut.load(std::memory_order_relaxed) << '\n';
+
+    family(out, "stomp_client_connects_total", "counter", "TCP connections made to the broker.");
+    out << "stomp_client_connects_total " << metrics.connects.load(std::memory_order_relaxed) << '\n';
+
+    family(out, "stomp_client_reconnects_total", "counter", "Connections re-established after the connection was lost.");
+    out << "stomp_client_reconnects_total " << metrics.reconnects.load(std::memory_order_relaxed) << '\n';
+
+    family(out, "stomp_client_outage_seconds_total", "counter", "Time spent reconnecting after the connection was lost.");
+    out << "stomp_client_outage_seconds_total " << metrics.outageNs.load(std::memory_order_relaxed) / 1e9 << '\n';
+
+    family(out, "stomp_client_last_outage_seconds", "gauge", "Length of the most recent outage that ended in a reconnect.");
+    out << "stomp_client_last_outage_seconds " << metrics.lastOutageNs.load(std::memory_order_relaxed) / 1e9 << '\n';
+
+    family(out, "stomp_client_reconnecting", "gauge", "1 while the connection is lost and being re-established.");
+    out << "stomp_client_reconnecting " << (protocol.isReconnecting() ? 1 : 0) << '\n';
+
+    family(out, "stomp_client_receipt_timeouts_total", "counter", "Receipts that did not arrive in time.");
+    out << "stomp_client_receipt_timeouts_total " << metrics.receiptTimeouts.load(std::memory_order_relaxed) << '\n';
+
+    family(out, "stomp_client_heart_beat_timeouts_total", "counter", "Connections dropped because the broker fell silent.");
+    out << "stomp_client_heart_beat_timeouts_total " << metrics.heartBeatTimeouts.load(std::memory_order_relaxed) << '\n';
+
+    family(out, "stomp_client_pending_receipts", "gauge", "Frames sent that are still waiting for their receipt.");
+    out << "stomp_client_pending_receipts " << protocol.getPendingReceipts() << '\n';
+
+    family(out, "stomp_client_logged_in", "gauge", "1 while logged in to the broker.");
+    out << "stomp_client_logged_in " << (protocol.isLoggedIn() ? 1 : 0) << '\n';
+
+    family(out, "stomp_client_outbound_queue_bytes", "gauge", "Bytes written to the socket but not yet acknowledged by the broker.");
+    out << "stomp_client_outbound_queue_bytes " << protocol.getOutboundQueueBytes() << '\n';
+
+    family(out, "stomp_client_inbound_queue_depth", "gauge", "Frames read from the socket waiting to be decoded.");
+    out << "stomp_client_inbound_queue_depth " << protocol.getQueueStats().depth << '\n';
+
+    std::vector<QueueStats> decoders = protocol.getDecoderQueueStats();
+    family(out, "stomp_client_decoder_queue_depth", "gauge", "MESSAGE frames waiting for a decode worker, by worker.");
+    for (size_t i = 0; i < decoders.size(); ++i)
+        out << "stomp_client_decoder_queue_depth{worker=\"" << i << "\"} " << decoders[i].depth << '\n';
+
+    std::vector<ChannelMemory> channels = protocol.getMemoryUsage();
+
+    family(out, "stomp_client_events_stored", "gauge", "Events held in the client's store, by channel.");
+    for (const ChannelMemory& channel : channels)
+        out << "stomp_client_events_stored{channel=\"" << labelValue(channel.channel) << "\"} " << channel.events << '\n';
+
+    family(out, "stomp_client_store_bytes", "gauge", "Memory reserved by the client's store, by channel.");
+    for (const ChannelMemory& channel : channels)
+        out << "stomp_client_store_bytes{channel=\"" << labelValue(channel.channel) << "\"} " << channel.reserved << '\n';
+
+    return out.str();
+}
@@ -8,10 +8,25 @@
 #include <ctime>
 #include <iomanip>
 #include <set>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <functional>
+
+#include "Histogram.h"
+#include "Latency.h"
+#include "Trace.h"
+#include "LockProfiler.h"
+#include "Log.h"
 
 using Command = void (*)(const std::vector<std::string>&, StompProtocol&);
 
 bool Parser::_sQuit = false;
+bool Parser::_sBusy = false;
+std::vector<std::function<void()>> Parser::_sWhenDone;
+std::unique_ptr<MetricsExporter> Parser::_sMetrics;
 
 
 bool Parser::shouldQuit()
@@ -19,6 +34,31 @@ bool Parser::shouldQuit()
     return _sQuit;
 }
 
+bool Parser::isBusy()
+{
+    return _sBusy;
+}
+
+void Parser::whenDone(std::function<void()> done)
+{
+    if (_sBusy)
+        _sWhenDone.push_back(std::move(done));
+    else
+        done();
+}
+
+// A waiter may start another long command; the ones after it wait on for that
+void Parser::commandDone()
+{
+    _sBusy = false;
+
+    std::vector<std::function<void()>> waiting;
+    waiting.swap(_sWhenDone);
+
+    for (std::function<void()>& done : waiting)
+        whenDone(std::move(done));
+}
+
 void Parser::parseCommand(const std::string &input, StompProtocol &protocol)
 {
     if (input.empty())
@@ -32,7 +72,18 @@ void Parser::parseCommand(const std::string &input, StompProtocol &protocol)
         {"report", {Parser::report, 2}},
         {"summary", {Parser::summary, 4}},
         {"logout", {Parser::logout, 1}},
-        {"quit", {Parser::quit, 1}}
+        {"quit", {Parser::quit, 1}},
+        {"mem", {Parser::mem, 1}},
+        {"queue", {Parser::queue, 1}},
+        {"record", {Parser::record, 2}},
+        {"bench", {Parser::bench, 4}},
+        {"latency", {Parser::latency, 1}},
+        {"metrics", {Parser::metrics, 1}},
+        {"trace", {Parser::trace, 2}},
+        {"locks", {Parser::locks, 1}},
+        {"log", {Parser::log, 1}},
+        {"reconnect", {Parser::reconnect, 1}},
+        {"heartbeat", {Parser::heartbeat, 1}}
     };
 
     std::vector<std::string> args = parseArgs(input);
@@ -49,8 +100,19 @@ void Parser::parseCommand(const std::string &input, StompProtocol &protocol)
         return;
     }
 
+    Command command = it->second.first;
+    runCommand([command, &args, &protocol]() { command(args, protocol); }, protocol);
+}
+
+void Parser::reportEvents(std::vector<Event>& events, StompProtocol& protocol)
+{
+    runCommand([&events, &protocol]() { sendReports(events, protocol); }, protocol);
+}
+
+void Parser::runCommand(const std::function<void()>& command, StompProtocol& protocol)
+{
     try {
-        (*it->second.first)(args, protocol);
+        command();
 
     } catch (boost::system::system_error& e) {
         std::cerr << "Socket Error: " << e.what() << '\n';
@@ -72,6 +134,7 @@ std::vector<std::string> Parser::parseArgs(const std::string &input)
 
 void Parser::writeSummary(const std::string &fileName, const std::vector<Event> &reports)
 {
+    TRACE_SCOPE("summary", "render");
     std::string channelName = reports.front().get_channel_name();
     size_t activeCount = 0;
     size_t forcesArrivalCount = 0;
@@ -124,21 +187,8 @@ std::string Parser::epochToString(time_t val)
 
 void Parser::login(const std::vector<std::string> &args, StompProtocol &protocol)
 {
-    std::string address = args[1];
-    std::string user = args[2];
-    std::string password = args[3];
-
-    size_t colonPos = address.find(':');
-
-    if (colonPos == std::string::npos)
-        throw std::invalid_argument("Invalid address: '" + address + '\'');
-    
-    protocol.login(
-        address.substr(0, colonPos),
-        static_cast<short>(std::stoi(address.substr(colonPos + 1))),
-        user,
-        password
-    );
+    // <host>:<port>, uring:<host>:<port>, unix:<path> or mem:<name>
+    protocol.login(args[1], args[2], args[3]);
 }
 
 void Parser::join(const std::vector<std::string>& args, StompProtocol& protocol)
@@ -153,9 +203,12 @@ void Parser::exit(const std::vector<std::string>& args, StompProtocol& protocol)
 
 void Parser::report(const std::vector<std::string>& args, StompProtocol& protocol)
 {
-    const std::string& file = args[1];
-    std::vector<Event> events = Event::fromJsonFile(file);
+    std::vector<Event> events = Event::fromJsonFile(args[1]);
+    sendReports(events, protocol);
+}
 
+void Parser::sendReports(std::vector<Event>& events, StompProtocol& protocol)
+{
     if (events.empty())
         return;
 
@@ -171,6 +224,7 @@ void Parser::summary(const std::vector<std::string>& args, StompProtocol& protoc
     const std::string& user = args[2];
     const std::string& file = args[3];
 
+    TRACE_SCOPE("summary", "summary");
     std::vector<Event> reports = protocol.getReportsFrom(channel, user);
 
     if (reports.empty()) {
@@ -188,5 +242,480 @@ void Parser::logout(const std::vector<std::string>& args, StompProtocol& protoco
 
 void Parser::quit(const std::vector<std::string> &, StompProtocol &)
 {
+    _sMetrics.reset();
+
+    if (Trace::enabled())
+        Trace::stop();
+
     _sQuit = true;
 }
+
+void Parser::mem(const std::vector<std::string> &, StompProtocol &protocol)
+{
+    std::vector<ChannelMemory> usage = protocol.getMemoryUsage();
+
+    if (usage.empty()) {
+        std::cout << "No events stored\n";
+        return;
+    }
+
+    std::ostream out(std::cout.rdbuf()); // own flags, so std::cout keeps its format
+    out << std::left << std::setw(20) << "channel"
+        << std::right << std::setw(10) << "events"
+        << std::setw(14) << "used (B)"
+        << std::setw(14) << "reserved (B)"
+        << std::setw(16) << "fragmentation" << '\n';
+
+    for (const ChannelMemory& channel : usage) {
+        out << std::left << std::setw(20) << channel.channel
+            << std::right << std::setw(10) << channel.events
+            << std::setw(14) << channel.used
+            << std::setw(14) << channel.reserved
+            << std::setw(15) << std::fixed << std::setprecision(1)
+            << channel.fragmentation() * 100 << "%\n";
+    }
+}
+
+void Parser::queue(const std::vector<std::string> &, StompProtocol &protocol)
+{
+    QueueStats stats = protocol.getQueueStats();
+
+    std::cout << "Inbound frames queued: " << stats.depth << '\n'
+              << "High-water mark: " << stats.highWaterMark << '\n'
+              << "Capacity: " << stats.capacity << '\n';
+
+    std::vector<QueueStats> decoders = protocol.getDecoderQueueStats();
+
+    for (size_t i = 0; i < decoders.size(); ++i) {
+        std::cout << "Decoder " << i << ": " << decoders[i].depth << " queued, high-water mark "
+                  << decoders[i].highWaterMark << " of " << decoders[i].capacity << '\n';
+    }
+}
+
+void Parser::record(const std::vector<std::string> &args, StompProtocol &protocol)
+{
+    SessionRecorder& recorder = protocol.recorder();
+
+    if (args[1] == "stop") {
+        uint64_t frames = recorder.framesRecorded();
+        recorder.stop();
+        std::cout << "Recorded " << frames << " frames to '" << recorder.path() << "'\n";
+        return;
+    }
+
+    recorder.start(args[1]);
+    std::cout << "Recording inbound frames to '" << args[1] << "'\n";
+}
+
+static int64_t monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+
+// A bench run, driven by handlers on the protocol's io_context: one event
+// goes out per turn of the loop, so the echoes are read in between and the
+// broker never blocks writing them to us, then a timer waits for the rest
+class BenchRun : public std::enable_shared_from_this<BenchRun>
+{
+public:
+    BenchRun(StompProtocol& protocol, const std::string& channel, size_t count, size_t size,
+             std::function<void()> done)
+        : _protocol(protocol)
+        , _channel(channel)
+        , _count(count)
+        , _size(size)
+        , _run(std::to_string(std::random_device()()) + ':')
+        , _event(channel, "bench", "bench", static_cast<int>(std::time(nullptr)), std::string(size, 'x'),
+                 {{"active", "false"}, {"forces_arrival_at_scene", "false"}})
+        , _results(std::make_shared<Results>())
+        , _out(std::cout.rdbuf())
+        , _timer(protocol.ioContext())
+        , _done(std::move(done))
+        , _sent(0)
+        , _failed(false)
+        , _startNs(0)
+        , _sentNs(0)
+        , _seen(0)
+        , _progressNs(0)
+    {
+    }
+
+    BenchRun(const BenchRun&) = delete;
+    BenchRun& operator=(const BenchRun&) = delete;
+
+    void start()
+    {
+        std::shared_ptr<Results> results = _results;
+        const std::string run = _run;
+
+        _protocol.setMessageListener([results, run](const Frame& f) {
+            const std::string& sent = f.getHeader(StompProtocol::BENCH_HEADER);
+
+            if (sent.compare(0, run.length(), run) != 0)
+                return false;
+
+            int64_t now = monotonicNs();
+            std::lock_guard<std::mutex> lck(results->mtx);
+
+            if (!results->closed) {
+                results->latency.record(now - std::stoll(sent.substr(run.length())));
+                results->last.store(now, std::memory_order_relaxed);
+                results->received.fetch_add(1, std::memory_order_release);
+            }
+            return true;
+        });
+
+        _startNs = monotonicNs();
+        sendNext();
+    }
+
+private:
+    // the channel's events are all handled on one decode thread, which
+    // publishes each latency to the loop through received. The lock keeps
+    // a listener call still in flight once it is removed off the histogram.
+    struct Results
+    {
+        std::mutex mtx;
+        Histogram latency;
+        bool closed;
+        std::atomic<size_t> received;
+        std::atomic<int64_t> last;
+
+        Results() : mtx(), latency(), closed(false), received(0), last(0) {}
+    };
+
+    static const int64_t PATIENCE_NS = 5000000000;
+
+    StompProtocol& _protocol;
+    std::string _channel;
+    size_t _count;
+    size_t _size;
+    std::string _run; // tags this run's events, so benchmarks other clients run on the channel are ignored
+    Event _event;
+    std::shared_ptr<Results> _results;
+    std::streambuf* _out; // where the command's output went when it started
+    boost::asio::steady_timer _timer;
+    std::function<void()> _done;
+    size_t _sent;
+    bool _failed;
+    int64_t _startNs;
+    int64_t _sentNs;
+    size_t _seen;
+    int64_t _progressNs;
+
+    void sendNext()
+    {
+        if (_sent < _count && !_failed && _protocol.isLoggedIn()) {
+            try {
+                _protocol.report(_event, {{StompProtocol::BENCH_HEADER, _run + std::to_string(monotonicNs())}});
+                ++_sent;
+            } catch (std::exception& e) {
+                std::ostream(_out) << "Error: " << e.what() << '\n';
+                _failed = true;
+            }
+
+            std::shared_ptr<BenchRun> self = shared_from_this();
+            boost::asio::post(_protocol.ioContext(), [self]() { self->sendNext(); });
+            return;
+        }
+
+        _sentNs = monotonicNs();
+        _progressNs = _sentNs;
+        awaitEchoes();
+    }
+
+    // until everything came back, or nothing has for a while
+    void awaitEchoes()
+    {
+        size_t received = _results->received.load(std::memory_order_acquire);
+        int64_t now = monotonicNs();
+
+        if (received != _seen) {
+            _seen = received;
+            _progressNs = now;
+        }
+
+        if (received >= _sent || now - _progressNs >= PATIENCE_NS) {
+            finish();
+            return;
+        }
+
+        std::shared_ptr<BenchRun> self = shared_from_this();
+        _timer.expires_after(std::chrono::milliseconds(1));
+        _timer.async_wait([self](const boost::system::error_code&) { self->awaitEchoes(); });
+    }
+
+    void finish()
+    {
+        _protocol.setMessageListener(nullptr);
+
+        Histogram latency;
+        size_t received;
+
+        {
+            std::lock_guard<std::mutex> lck(_results->mtx);
+            _results->closed = true;
+            latency = _results->latency;
+            received = _results->received.load();
+        }
+
+        double sendSeconds = (_sentNs - _startNs) / 1e9;
+        double totalSeconds = (_results->last.load() - _startNs) / 1e9;
+
+        // a stream of its own, so the flags of std::cout stay as they were
+        std::ostream out(_out);
+        out << std::fixed << std::setprecision(1);
+        report(out, latency, received, sendSeconds, totalSeconds);
+        _done();
+    }
+
+    void report(std::ostream& out, const Histogram& latency, size_t received, double sendSeconds, double totalSeconds)
+    {
+        if (_sent < _count)
+            out << "Stopped after " << _sent << " of " << _count << " events\n";
+
+        if (_sent == 0)
+            return;
+
+        out << "Sent " << _sent << " events of " << _size << " B to '" << _channel << "' in "
+            << sendSeconds * 1000 << " ms (" << std::setprecision(0) << _sent / sendSeconds << "/s)\n";
+
+        if (received == 0) {
+            out << "No events came back\n";
+            return;
+        }
+
+        out << "Received " << received << " of " << _sent << " in " << std::setprecision(1) << totalSeconds * 1000
+            << " ms (" << std::setprecision(0) << received / totalSeconds << "/s)\n"
+            << "Round-trip latency: ";
+
+        latency.printSummary(out, 1000.0, "us");
+    }
+};
+
+}
+
+// Returns once the run has started; the loop carries it on, and the next
+// command waits for it through whenDone
+void Parser::bench(const std::vector<std::string> &args, StompProtocol &protocol)
+{
+    const std::string& channel = args[1];
+    size_t count = std::stoul(args[2]);
+    size_t size = std::stoul(args[3]);
+
+    if (count == 0)
+        throw std::invalid_argument("Nothing to send: count must be at least 1");
+
+    if (!protocol.isSubscribed(channel))
+        throw std::invalid_argument("Not subscribed to '" + channel + '\'');
+
+    _sBusy = true;
+    std::make_shared<BenchRun>(protocol, channel, count, size, []() { commandDone(); })->start();
+}
+
+void Parser::latency(const std::vector<std::string> &args, StompProtocol &)
+{
+    if (!Latency::enabled()) {
+        std::cout << "Latency instrumentation was compiled out (STOMP_NO_LATENCY)\n";
+        return;
+    }
+
+    if (args.size() > 1 && args[1] == "reset") {
+        Latency::reset();
+        std::cout << "Latency histograms cleared\n";
+        return;
+    }
+
+    std::ostream out(std::cout.rdbuf());
+    std::vector<Histogram> spans = Latency::snapshot();
+
+    out << std::left << std::setw(20) << "span (us)"
+        << std::right << std::setw(10) << "count"
+        << std::setw(10) << "p50"
+        << std::setw(10) << "p90"
+        << std::setw(10) << "p99"
+        << std::setw(10) << "p99.9"
+        << std::setw(10) << "max" << '\n';
+
+    for (size_t i = 0; i < spans.size(); ++i) {
+        const Histogram& h = spans[i];
+
+        out << std::left << std::setw(20) << Latency::name(static_cast<LatencySpan>(i))
+            << std::right << std::setw(10) << h.count();
+
+        if (h.count() == 0) {
+            out << '\n';
+            continue;
+        }
+
+        out << std::fixed << std::setprecision(1)
+            << std::setw(10) << h.percentile(50) / 1000.0
+            << std::setw(10) << h.percentile(90) / 1000.0
+            << std::setw(10) << h.percentile(99) / 1000.0
+            << std::setw(10) << h.percentile(99.9) / 1000.0
+            << std::setw(10) << h.max() / 1000.0 << '\n';
+    }
+}
+
+void Parser::metrics(const std::vector<std::string> &args, StompProtocol &protocol)
+{
+    if (args.size() == 1) {
+        std::cout << MetricsExporter::render(protocol);
+        return;
+    }
+
+    if (args[1] == "stop") {
+        _sMetrics.reset();
+        std::cout << "Stopped exporting metrics\n";
+        return;
+    }
+
+    if (args.size() < 3)
+        throw std::invalid_argument("Usage: metrics [file <path> [interval] | http <port> | stop]");
+
+    if (!_sMetrics)
+        _sMetrics.reset(new MetricsExporter(protocol));
+
+    if (args[1] == "file") {
+        double interval = args.size() > 3 ? std::stod(args[3]) : 15;
+
+        if (interval <= 0)
+            throw std::invalid_argument("Interval must be positive");
+
+        _sMetrics->writeFile(args[2], interval);
+    } else if (args[1] == "http") {
+        _sMetrics->serveHttp(static_cast<unsigned short>(std::stoi(args[2])));
+    } else {
+        throw std::invalid_argument("Unknown metrics output: '" + args[1] + "'");
+    }
+
+    std::cout << "Metrics: " << _sMetrics->describe() << '\n';
+}
+
+void Parser::trace(const std::vector<std::string> &args, StompProtocol &)
+{
+    if (args[1] == "stop") {
+        TraceStats stats = Trace::stop();
+        std::cout << "Traced " << stats.events << " events";
+        if (stats.dropped) std::cout << ", " << stats.dropped << " dropped";
+        std::cout << '\n';
+        return;
+    }
+
+    Trace::start(args[1]);
+    std::cout << "Tracing to '" << args[1] << "'\n";
+}
+
+void Parser::locks(const std::vector<std::string> &args, StompProtocol &)
+{
+    if (args.size() > 1) {
+        if (args[1] == "on") {
+            LockProfiler::enable(true);
+            std::cout << "Lock profiling on\n";
+        } else if (args[1] == "off") {
+            LockProfiler::enable(false);
+            std::cout << "Lock profiling off\n";
+        } else if (args[1] == "reset") {
+            LockProfiler::reset();
+            std::cout << "Lock statistics cleared\n";
+        } else {
+            throw std::invalid_argument("Usage: locks [on|off|reset]");
+        }
+        return;
+    }
+
+    std::ostream out(std::cout.rdbuf());
+
+    if (!LockProfiler::enabled())
+        out << "Lock profiling is off, 'locks on' starts it\n";
+
+    out << std::left << std::setw(16) << "lock"
+        << std::right << std::setw(12) << "acquired"
+        << std::setw(12) << "contended"
+        << std::setw(14) << "wait (ms)"
+        << std::setw(14) << "max wait (us)"
+        << std::setw(12) << "hold p50"
+        << std::setw(12) << "hold p99"
+        << std::setw(12) << "hold max" << " (us)\n";
+
+    for (const LockStats& lock : LockProfiler::snapshot()) {
+        out << std::left << std::setw(16) << lock.site
+            << std::right << std::setw(12) << lock.acquisitions
+            << std::setw(12) << lock.contended
+            << std::fixed << std::setprecision(3)
+            << std::setw(14) << lock.totalWaitNs / 1e6
+            << std::setprecision(1)
+            << std::setw(14) << lock.maxWaitNs / 1e3
+            << std::setw(12) << lock.holdNs.percentile(50) / 1e3
+            << std::setw(12) << lock.holdNs.percentile(99) / 1e3
+            << std::setw(12) << lock.holdNs.max() / 1e3 << '\n';
+    }
+}
+
+void Parser::log(const std::vector<std::string> &args, StompProtocol &)
+{
+    if (args.size() > 2 && args[1] == "level") {
+        Log::setLevel(Log::parseLevel(args[2]));
+    } else if (args.size() > 2 && args[1] == "overflow") {
+        if (args[2] == "drop") Log::setOverflow(LogOverflow::DROP);
+        else if (args[2] == "block") Log::setOverflow(LogOverflow::BLOCK);
+        else throw std::invalid_argument("Unknown overflow policy: '" + args[2] + '\'');
+    } else if (args.size() > 1) {
+        throw std::invalid_argument("Usage: log [level <debug|info|warn|error|off> | overflow <drop|block>]");
+    }
+
+    LogStats stats = Log::stats();
+
+    std::cout << "Level: " << Log::levelName(Log::level())
+              << ", on overflow: " << (Log::overflow() == LogOverflow::DROP ? "drop" : "block") << '\n'
+              << "Lines written: " << stats.written << ", dropped: " << stats.dropped << '\n'
+              << "Queued: " << stats.queue.depth << ", high-water mark " << stats.queue.highWaterMark
+              << " of " << stats.queue.capacity << '\n';
+}
+
+void Parser::reconnect(const std::vector<std::string> &args, StompProtocol &protocol)
+{
+    if (args.size() > 1) {
+        if (args[1] == "on")
+            protocol.setAutoReconnect(true);
+        else if (args[1] == "off")
+            protocol.setAutoReconnect(false);
+        else
+            throw std::invalid_argument("Usage: reconnect [on|off]");
+    }
+
+    std::ostream out(std::cout.rdbuf());
+    const ClientMetrics& metrics = protocol.getMetrics();
+
+    out << "Auto-reconnect " << (protocol.autoReconnect() ? "on" : "off")
+        << (protocol.isReconnecting() ? ", reconnecting now" : "") << '\n'
+        << "Reconnects: " << metrics.reconnects.load()
+        << std::fixed << std::setprecision(1)
+        << ", last outage " << metrics.lastOutageNs.load() / 1e6 << " ms"
+        << ", " << metrics.outageNs.load() / 1e6 << " ms in total\n";
+}
+
+void Parser::heartbeat(const std::vector<std::string> &args, StompProtocol &protocol)
+{
+    if (args.size() == 3) {
+        protocol.setHeartBeat({
+            static_cast<uint32_t>(std::stoul(args[1])),
+            static_cast<uint32_t>(std::stoul(args[2]))
+        });
+    } else if (args.size() != 1) {
+        throw std::invalid_argument("Usage: heartbeat [<send ms> <receive ms>]");
+    }
+
+    HeartBeat asked = protocol.heartBeat();
+    HeartBeat agreed = protocol.negotiatedHeartBeat();
+
+    std::cout << "Asked for at login: send every " << asked.send << " ms, receive every " << asked.receive << " ms\n";
+
+    if (protocol.isLoggedIn()) {
+        std::cout << "Agreed: send every " << agreed.send << " ms, receive every " << agreed.receive << " ms"
+                  << " (0: off), dead after " << StompProtocol::HEART_BEAT_TOLERANCE << "x silence\n";
+    }
+}
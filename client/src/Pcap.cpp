@@ -0,0 +1,346 @@
+#include "Pcap.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <arpa/inet.h>
+
+#include "Frame.h"
+
+
+namespace {
+
+const uint16_t ETHERTYPE_IPV4 = 0x0800;
+const uint16_t ETHERTYPE_IPV6 = 0x86DD;
+const uint16_t ETHERTYPE_VLAN = 0x8100;
+const uint8_t IPPROTO_TCP_NUMBER = 6;
+
+const uint8_t TCP_SYN = 0x02;
+const uint8_t TCP_ACK = 0x10;
+
+struct Segment
+{
+    uint32_t seq;
+    double time;
+    std::string data;
+};
+
+// one direction of a connection
+struct Flow
+{
+    bool sawSyn;
+    uint32_t isn;
+    std::vector<Segment> segments;
+
+    Flow() : sawSyn(false), isn(0), segments() {}
+};
+
+struct Connection
+{
+    std::string a;
+    std::string b;
+    std::string initiator; // sent a SYN without ACK, if the capture saw one
+    std::map<std::string, Flow> flows; // by sender
+
+    Connection() : a(), b(), initiator(), flows() {}
+};
+
+class Bytes
+{
+public:
+    Bytes(const std::string& data, bool swapped) : _data(data), _swapped(swapped) {}
+
+    bool has(size_t offset, size_t length) const { return offset + length <= _data.size(); }
+    uint8_t u8(size_t offset) const { return static_cast<uint8_t>(_data[offset]); }
+    uint16_t be16(size_t offset) const { return static_cast<uint16_t>(u8(offset) << 8 | u8(offset + 1)); }
+    uint32_t be32(size_t offset) const { return static_cast<uint32_t>(be16(offset)) << 16 | be16(offset + 2); }
+
+    // a field of the capture file itself, in the byte order of its writer
+    uint32_t file32(size_t offset) const
+    {
+        uint32_t value = static_cast<uint32_t>(u8(offset + 3)) << 24 | static_cast<uint32_t>(u8(offset + 2)) << 16
+                       | static_cast<uint32_t>(u8(offset + 1)) << 8 | u8(offset);
+        return _swapped ? __builtin_bswap32(value) : value;
+    }
+
+private:
+    const std::string& _data;
+    bool _swapped;
+};
+
+std::string endpoint(const Bytes& bytes, size_t address, int family, uint16_t port)
+{
+    unsigned char raw[16];
+    size_t length = (family == AF_INET) ? 4 : 16;
+    for (size_t i = 0; i < length; ++i) raw[i] = bytes.u8(address + i);
+
+    char text[INET6_ADDRSTRLEN];
+    inet_ntop(family, raw, text, sizeof(text));
+
+    return (family == AF_INET ? std::string(text) : '[' + std::string(text) + ']') + ':' + std::to_string(port);
+}
+
+// offset of the IP header in a packet, or 0 when the packet is not IP
+size_t ipOffset(const Bytes& bytes, size_t packet, size_t length, uint32_t linkType)
+{
+    switch (linkType) {
+        case 0:   // BSD loopback
+            return length > 4 ? packet + 4 : 0;
+
+        case 1: { // Ethernet
+            size_t offset = packet + 12;
+            uint16_t type = bytes.be16(offset);
+
+            if (type == ETHERTYPE_VLAN) {
+                offset += 4;
+                type = bytes.be16(offset);
+            }
+
+            return (type == ETHERTYPE_IPV4 || type == ETHERTYPE_IPV6) ? offset + 2 : 0;
+        }
+
+        case 101: // raw IP
+        case 228:
+        case 229:
+            return packet;
+
+        case 113: // Linux cooked capture
+            return bytes.be16(packet + 14) == ETHERTYPE_IPV4 || bytes.be16(packet + 14) == ETHERTYPE_IPV6 ? packet + 16 : 0;
+
+        case 276: // Linux cooked capture v2
+            return bytes.be16(packet) == ETHERTYPE_IPV4 || bytes.be16(packet) == ETHERTYPE_IPV6 ? packet + 20 : 0;
+
+        default:
+            throw std::runtime_error("Unsupported link type " + std::to_string(linkType));
+    }
+}
+
+// the stream one flow carried, split into frames stamped with the time their '\0' arrived
+size_t assemble(Flow& flow, std::vector<TimedFrame>& frames)
+{
+    if (flow.segments.empty())
+        return 0;
+
+    uint32_t base = flow.sawSyn ? flow.isn + 1 : flow.segments.front().seq;
+
+    std::stable_sort(flow.segments.begin(), flow.segments.end(), [base](const Segment& x, const Segment& y) {
+        return static_cast<int32_t>(x.seq - base) < static_cast<int32_t>(y.seq - base);
+    });
+
+    std::string pending;
+    size_t end = 0; // stream offset right after the last byte taken
+    size_t missing = 0;
+
+    for (const Segment& segment : flow.segments) {
+        int32_t relative = static_cast<int32_t>(segment.seq - base);
+
+        if (relative < 0 || relative + segment.data.length() <= end)
+            continue; // before the start of the stream, or retransmitted
+
+        if (static_cast<size_t>(relative) > end) {
+            missing += relative - end;
+            end = relative;
+        }
+
+        size_t skip = end - relative;
+        size_t from = 0;
+        const std::string& data = segment.data;
+
+        for (size_t nul = data.find('\0', skip); nul != std::string::npos; nul = data.find('\0', from)) {
+            pending.append(data, std::max(from, skip), nul + 1 - std::max(from, skip));
+            frames.push_back({segment.time, std::move(pending)});
+            pending.clear();
+            from = nul + 1;
+        }
+
+        if (std::max(from, skip) < data.length())
+            pending.append(data, std::max(from, skip), std::string::npos);
+
+        end = relative + data.length();
+    }
+
+    return missing;
+}
+
+bool startsWithCommand(const std::vector<TimedFrame>& frames, const char* command)
+{
+    if (frames.empty())
+        return false;
+
+    const std::string& bytes = frames.front().bytes;
+    size_t start = bytes.find_first_not_of("\r\n");
+    return start != std::string::npos && bytes.compare(start, std::char_traits<char>::length(command), command) == 0;
+}
+
+std::string connectHeader(const std::vector<TimedFrame>& frames, const std::string& header)
+{
+    for (const TimedFrame& frame : frames) {
+        size_t start = frame.bytes.find_first_not_of("\r\n");
+
+        if (start == std::string::npos || frame.bytes.compare(start, 8, "CONNECT\n") != 0)
+            continue;
+
+        size_t end = frame.bytes.find_last_not_of('\0');
+        return Frame::parseFrame(frame.bytes.substr(start, end + 1 - start)).getHeader(header);
+    }
+
+    return "";
+}
+
+}
+
+std::vector<TcpConversation> TcpConversation::fromPcapFile(const std::string &path)
+{
+    std::ifstream f(path, std::ios::binary);
+
+    if (!f)
+        throw std::runtime_error("Cannot open '" + path + '\'');
+
+    std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    Bytes header(data, false);
+
+    if (!header.has(0, 24))
+        throw std::runtime_error('\'' + path + "' is not a pcap file");
+
+    uint32_t magic = header.file32(0);
+    bool swapped = (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1);
+    bool nanoseconds = (magic == 0xa1b23c4d || magic == 0x4d3cb2a1);
+
+    if (magic == 0x0a0d0d0a)
+        throw std::runtime_error('\'' + path + "' is pcapng; convert it with: editcap -F pcap in.pcapng out.pcap");
+
+    if (!swapped && magic != 0xa1b2c3d4 && magic != 0xa1b23c4d)
+        throw std::runtime_error('\'' + path + "' is not a pcap file");
+
+    Bytes bytes(data, swapped);
+    uint32_t linkType = bytes.file32(20) & 0x0fffffff;
+    double tickSeconds = nanoseconds ? 1e-9 : 1e-6;
+
+    std::vector<Connection> connections;
+    std::map<std::string, size_t> connectionIndex;
+    double firstTime = -1;
+
+    for (size_t offset = 24; bytes.has(offset, 16); ) {
+        double time = bytes.file32(offset) + bytes.file32(offset + 4) * tickSeconds;
+        size_t length = bytes.file32(offset + 8);
+        size_t packet = offset + 16;
+        offset = packet + length;
+
+        if (!bytes.has(packet, length))
+            break; // truncated capture
+
+        if (firstTime < 0)
+            firstTime = time;
+
+        size_t ip = ipOffset(bytes, packet, length, linkType);
+        size_t packetEnd = packet + length;
+
+        if (ip == 0 || ip >= packetEnd)
+            continue;
+
+        int family;
+        size_t tcp;
+        size_t ipEnd;
+        size_t source;
+        size_t destination;
+
+        if ((bytes.u8(ip) >> 4) == 4 && ip + 20 <= packetEnd) {
+            if (bytes.u8(ip + 9) != IPPROTO_TCP_NUMBER || (bytes.be16(ip + 6) & 0x3fff) != 0)
+                continue; // not TCP, or a fragment
+
+            family = AF_INET;
+            tcp = ip + (bytes.u8(ip) & 0x0f) * 4;
+            ipEnd = std::min(packetEnd, ip + bytes.be16(ip + 2));
+            source = ip + 12;
+            destination = ip + 16;
+        } else if ((bytes.u8(ip) >> 4) == 6 && ip + 40 <= packetEnd) {
+            if (bytes.u8(ip + 6) != IPPROTO_TCP_NUMBER)
+                continue; // not TCP, or behind extension headers
+
+            family = AF_INET6;
+            tcp = ip + 40;
+            ipEnd = std::min(packetEnd, tcp + bytes.be16(ip + 4));
+            source = ip + 8;
+            destination = ip + 24;
+        } else {
+            continue;
+        }
+
+        if (tcp + 20 > ipEnd)
+            continue;
+
+        std::string from = endpoint(bytes, source, family, bytes.be16(tcp));
+        std::string to = endpoint(bytes, destination, family, bytes.be16(tcp + 2));
+        uint32_t seq = bytes.be32(tcp + 4);
+        uint8_t flags = bytes.u8(tcp + 13);
+        size_t payload = tcp + (bytes.u8(tcp + 12) >> 4) * 4;
+
+        std::string key = std::min(from, to) + ' ' + std::max(from, to);
+        auto found = connectionIndex.find(key);
+
+        // a new SYN on a known address pair starts a new connection
+        if (found == connectionIndex.end() || ((flags & TCP_SYN) && !(flags & TCP_ACK) && connections[found->second].flows[from].sawSyn)) {
+            connections.emplace_back();
+            connections.back().a = from;
+            connections.back().b = to;
+            found = connectionIndex.emplace(key, 0).first;
+            found->second = connections.size() - 1;
+        }
+
+        Connection& connection = connections[found->second];
+        Flow& flow = connection.flows[from];
+
+        if (flags & TCP_SYN) {
+            flow.sawSyn = true;
+            flow.isn = seq;
+            if (!(flags & TCP_ACK)) connection.initiator = from;
+        }
+
+        if (payload < ipEnd)
+            flow.segments.push_back({seq, time - firstTime, data.substr(payload, ipEnd - payload)});
+    }
+
+    std::vector<TcpConversation> conversations;
+
+    for (Connection& connection : connections) {
+        TcpConversation conversation;
+        std::vector<TimedFrame> aFrames;
+        std::vector<TimedFrame> bFrames;
+
+        conversation.missingBytes = assemble(connection.flows[connection.a], aFrames)
+                                  + assemble(connection.flows[connection.b], bFrames);
+
+        if (aFrames.empty() && bFrames.empty())
+            continue;
+
+        bool aIsClient;
+
+        if (!connection.initiator.empty())
+            aIsClient = (connection.initiator == connection.a);
+        else if (startsWithCommand(aFrames, "CONNECT") || startsWithCommand(aFrames, "STOMP"))
+            aIsClient = true;
+        else
+            aIsClient = startsWithCommand(bFrames, "CONNECTED") || startsWithCommand(bFrames, "MESSAGE");
+
+        conversation.client = aIsClient ? connection.a : connection.b;
+        conversation.server = aIsClient ? connection.b : connection.a;
+        conversation.clientFrames = std::move(aIsClient ? aFrames : bFrames);
+        conversation.serverFrames = std::move(aIsClient ? bFrames : aFrames);
+        conversations.push_back(std::move(conversation));
+    }
+
+    return conversations;
+}
+
+std::string TcpConversation::login() const
+{
+    return connectHeader(clientFrames, "login");
+}
+
+std::string TcpConversation::passcode() const
+{
+    return connectHeader(clientFrames, "passcode");
+}
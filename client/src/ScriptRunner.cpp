@@ -0,0 +1,290 @@
+#include "ScriptRunner.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+
+#include "Latency.h"
+#include "Parser.h"
+#include "StompProtocol.h"
+#include "Event.h"
+
+
+static const int64_t WAIT_TIMEOUT_NS = 10000000000LL; // a dependency this late is reported and skipped
+static const size_t NO_STEP = static_cast<size_t>(-1);
+
+ScriptRunner::ScriptRunner(StompProtocol& protocol)
+    : _protocol(protocol)
+    , _work(boost::asio::make_work_guard(protocol.ioContext()))
+    , _steps()
+    , _completed(0)
+    , _startNs(0)
+{
+}
+
+void ScriptRunner::load(std::istream& in)
+{
+    size_t lastBarrier = NO_STEP;
+    std::unordered_map<std::string, size_t> lastJoin;
+    std::unordered_map<std::string, size_t> lastExit;
+    std::unordered_map<std::string, std::vector<size_t>> reports;
+
+    std::string text;
+    size_t line = 0;
+
+    while (std::getline(in, text)) {
+        ++line;
+
+        std::vector<std::string> args = Parser::parseArgs(text);
+        if (args.empty() || args.front()[0] == '#')
+            continue;
+
+        size_t index = _steps.size();
+        Step step = {line, text, kindOf(args.front()), {}, 0, 0, 0, 0, 0, 0, false, false, {}};
+
+        if (step.kind != Kind::BARRIER && step.kind != Kind::LOGIN && step.kind != Kind::LOGOUT
+                && step.kind != Kind::QUIT && args.size() < 2) {
+            step.kind = Kind::BARRIER; // malformed: let the parser complain, in order
+        }
+
+        auto addAfter = [&step](const std::unordered_map<std::string, size_t>& steps, const std::string& key) {
+            auto it = steps.find(key);
+            if (it != steps.end()) step.after.push_back(it->second);
+        };
+
+        switch (step.kind) {
+            case Kind::JOIN:
+                addAfter(lastExit, args[1]);
+                lastJoin[args[1]] = index;
+                break;
+
+            case Kind::EXIT:
+                addAfter(lastJoin, args[1]);
+                lastExit[args[1]] = index;
+                break;
+
+            case Kind::REPORT: {
+                step.eventsRead = readReport(args[1], step.events);
+                std::string channel = step.events.empty() ? std::string() : step.events.front().get_channel_name();
+                addAfter(lastJoin, channel);
+                reports[channel].push_back(index);
+                break;
+            }
+
+            case Kind::SUMMARY: {
+                const std::vector<size_t>& before = reports[args[1]];
+                step.after.insert(step.after.end(), before.begin(), before.end());
+                break;
+            }
+
+            default:
+                // everything since the last barrier, which itself waited for the rest
+                for (size_t i = (lastBarrier == NO_STEP) ? 0 : lastBarrier; i < index; ++i)
+                    step.after.push_back(i);
+
+                lastBarrier = index;
+                lastJoin.clear();
+                lastExit.clear();
+                reports.clear();
+                break;
+        }
+
+        if (lastBarrier != NO_STEP && lastBarrier != index)
+            step.after.push_back(lastBarrier);
+
+        _steps.push_back(std::move(step));
+    }
+}
+
+void ScriptRunner::run()
+{
+    // a report is complete once its receipt is back
+    _protocol.setReportReceipts(true);
+    _startNs = Latency::now();
+
+    for (size_t i = 0; i < _steps.size() && !Parser::shouldQuit(); ++i) {
+        Step& step = _steps[i];
+        step.reachedNs = Latency::now();
+
+        if (!waitUntilReady(i, step)) {
+            std::cerr << "Line " << step.line << ": still waiting after "
+                      << WAIT_TIMEOUT_NS / 1000000000 << " s, running '" << step.text << "' anyway\n";
+        }
+
+        step.firstReceipt = _protocol.nextReceiptId();
+        step.issuedNs = Latency::now();
+
+        if (step.eventsRead) {
+            Parser::reportEvents(step.events, _protocol);
+            std::vector<Event>().swap(step.events);
+        } else {
+            Parser::parseCommand(step.text, _protocol);
+        }
+
+        step.ranNs = Latency::now();
+        step.lastReceipt = _protocol.nextReceiptId();
+
+        _protocol.pump(std::chrono::milliseconds(0));
+        updateCompleted(i + 1);
+    }
+
+    if (!Parser::shouldQuit()) {
+        // the end of the script quits, like the end of input does
+        Step last = {0, "quit", Kind::QUIT, {}, 0, 0, 0, 0, 0, 0, false, false, {}};
+        for (size_t i = 0; i < _steps.size(); ++i)
+            last.after.push_back(i);
+
+        if (!waitUntilReady(_steps.size(), last))
+            std::cerr << "Still waiting after " << WAIT_TIMEOUT_NS / 1000000000 << " s, quitting anyway\n";
+
+        Parser::parseCommand("quit", _protocol);
+    }
+
+    _protocol.setReportReceipts(false);
+    _work.reset();
+}
+
+void ScriptRunner::printTimings(std::ostream& out) const
+{
+    int64_t endNs = _startNs;
+    int64_t waitNs = 0;
+
+    out << std::right << std::setw(6) << "line"
+        << std::setw(12) << "wait (ms)"
+        << std::setw(12) << "run (ms)"
+        << std::setw(14) << "complete (ms)" << "  command\n";
+
+    for (const Step& step : _steps) {
+        if (step.issuedNs == 0)
+            break; // not reached: an earlier command quit
+
+        out << std::setw(6) << step.line
+            << std::fixed << std::setprecision(3)
+            << std::setw(12) << (step.issuedNs - step.reachedNs) / 1e6
+            << std::setw(12) << (step.ranNs - step.issuedNs) / 1e6;
+
+        if (step.doneNs != 0)
+            out << std::setw(14) << (step.doneNs - step.issuedNs) / 1e6;
+        else
+            out << std::setw(14) << "-";
+
+        out << "  " << step.text << '\n';
+
+        waitNs += step.issuedNs - step.reachedNs;
+        endNs = std::max(endNs, std::max(step.ranNs, step.doneNs));
+    }
+
+    out << std::fixed << std::setprecision(3)
+        << "Total " << (endNs - _startNs) / 1e6 << " ms, "
+        << waitNs / 1e6 << " ms of it waiting on dependencies\n";
+}
+
+bool ScriptRunner::isReady(const Step& step)
+{
+    for (size_t before : step.after) {
+        if (_steps[before].doneNs == 0 && !_steps[before].abandoned)
+            return false;
+    }
+
+    // the reports' MESSAGEs come back before their receipts, but may still be in the decoders
+    return step.kind != Kind::SUMMARY || _protocol.isDecodeIdle();
+}
+
+bool ScriptRunner::isComplete(Step& step)
+{
+    if (step.doneNs != 0)
+        return true;
+
+    bool complete;
+
+    switch (step.kind) {
+        case Kind::LOGIN:
+            // CONNECTED, or the connection failed or was refused
+            complete = _protocol.isLoggedIn() || !_protocol.isReceiving();
+            break;
+
+        case Kind::LOGOUT:
+            // "Logout successful" is out once the DISCONNECT's receipt is handled
+            complete = !_protocol.isReceiptPending(step.firstReceipt, step.lastReceipt) && _protocol.isDecodeIdle();
+            break;
+
+        case Kind::BARRIER:
+            // a bench goes on after its command returns
+            complete = !Parser::isBusy() && !_protocol.isReceiptPending(step.firstReceipt, step.lastReceipt);
+            break;
+
+        default:
+            complete = !_protocol.isReceiptPending(step.firstReceipt, step.lastReceipt);
+            break;
+    }
+
+    if (complete)
+        step.doneNs = Latency::now();
+
+    return complete;
+}
+
+void ScriptRunner::updateCompleted(size_t issued)
+{
+    while (_completed < issued && isComplete(_steps[_completed]))
+        ++_completed;
+
+    for (size_t i = _completed; i < issued; ++i)
+        isComplete(_steps[i]);
+}
+
+bool ScriptRunner::waitUntilReady(size_t issued, const Step& step)
+{
+    int64_t start = Latency::now();
+
+    while (true) {
+        updateCompleted(issued);
+
+        if (isReady(step))
+            return true;
+
+        if (Latency::now() - start > WAIT_TIMEOUT_NS) {
+            for (size_t before : step.after)
+                _steps[before].abandoned = _steps[before].doneNs == 0;
+
+            return false;
+        }
+
+        _protocol.pump(std::chrono::milliseconds(1));
+    }
+}
+
+ScriptRunner::Kind ScriptRunner::kindOf(const std::string& command)
+{
+    static const std::unordered_map<std::string, Kind> kinds = {
+        {"login", Kind::LOGIN},
+        {"logout", Kind::LOGOUT},
+        {"quit", Kind::QUIT},
+        {"join", Kind::JOIN},
+        {"exit", Kind::EXIT},
+        {"report", Kind::REPORT},
+        {"summary", Kind::SUMMARY}
+    };
+
+    auto it = kinds.find(command);
+    return (it == kinds.end()) ? Kind::BARRIER : it->second;
+}
+
+// Reads a report file once, for its channel and later its sending. A file
+// that cannot be read is left to the report command, which says what is
+// wrong when the step runs.
+bool ScriptRunner::readReport(const std::string& file, std::vector<Event>& events)
+{
+    if (!std::ifstream(file))
+        return false;
+
+    try {
+        events = Event::fromJsonFile(file);
+        return true;
+    } catch (std::exception&) {
+        events.clear();
+        return false;
+    }
+}
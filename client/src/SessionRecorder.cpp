@@ -0,0 +1,185 @@
+#include "SessionRecorder.h"
+
+#include <chrono>
+#include <iterator>
+#include <stdexcept>
+
+
+static const char MAGIC[] = "STOMPREC";
+static const size_t MAGIC_LENGTH = sizeof(MAGIC) - 1;
+static const char VERSION = 1;
+static const size_t WRITE_BUFFER_SIZE = 256 * 1024;
+
+static uint64_t monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void putVarint(std::ofstream& out, uint64_t value)
+{
+    char bytes[10];
+    size_t length = 0;
+
+    do {
+        char byte = static_cast<char>(value & 0x7f);
+        value >>= 7;
+        bytes[length++] = value ? static_cast<char>(byte | 0x80) : byte;
+    } while (value);
+
+    out.write(bytes, length);
+}
+
+static bool getVarint(const std::string& data, size_t& offset, uint64_t& value)
+{
+    value = 0;
+
+    for (unsigned shift = 0; offset < data.size() && shift < 64; shift += 7) {
+        unsigned char byte = static_cast<unsigned char>(data[offset++]);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+SessionRecorder::SessionRecorder()
+    : _recording(false)
+    , _mtx()
+    , _file()
+    , _path()
+    , _buffer(WRITE_BUFFER_SIZE)
+    , _lastNs(0)
+    , _frames(0)
+{
+}
+
+void SessionRecorder::start(const std::string &path)
+{
+    std::lock_guard<std::mutex> lck(_mtx);
+
+    if (_recording.load())
+        throw std::logic_error("Already recording to '" + _path + '\'');
+
+    std::ifstream existing(path, std::ios::binary | std::ios::ate);
+    bool empty = !existing || existing.tellg() == 0;
+    existing.close();
+
+    _file.rdbuf()->pubsetbuf(_buffer.data(), _buffer.size());
+    _file.open(path, std::ios::binary | std::ios::app);
+
+    if (!_file)
+        throw std::runtime_error("Cannot write to '" + path + '\'');
+
+    if (empty) {
+        _file.write(MAGIC, MAGIC_LENGTH);
+        _file.put(VERSION);
+    }
+
+    _lastNs = monotonicNs();
+    _frames = 0;
+    _path = path;
+
+    _file.put('S');
+    putVarint(_file, std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+
+    _recording.store(true);
+}
+
+void SessionRecorder::stop()
+{
+    std::lock_guard<std::mutex> lck(_mtx);
+
+    if (!_recording.load())
+        throw std::logic_error("Not recording");
+
+    _recording.store(false);
+    _file.close();
+    _file.clear();
+}
+
+bool SessionRecorder::isRecording() const
+{
+    return _recording.load();
+}
+
+std::string SessionRecorder::path() const
+{
+    std::lock_guard<std::mutex> lck(_mtx);
+    return _path;
+}
+
+uint64_t SessionRecorder::framesRecorded() const
+{
+    std::lock_guard<std::mutex> lck(_mtx);
+    return _frames;
+}
+
+void SessionRecorder::record(const std::string &rawFrame)
+{
+    if (!_recording.load(std::memory_order_relaxed))
+        return;
+
+    uint64_t now = monotonicNs();
+    std::lock_guard<std::mutex> lck(_mtx);
+
+    if (!_recording.load())
+        return;
+
+    _file.put('F');
+    putVarint(_file, now - _lastNs);
+    putVarint(_file, rawFrame.length());
+    _file.write(rawFrame.data(), rawFrame.length());
+
+    _lastNs = now;
+    ++_frames;
+}
+
+std::vector<TimedFrame> SessionRecorder::load(const std::string &path, size_t *sessions)
+{
+    std::ifstream f(path, std::ios::binary);
+
+    if (!f)
+        throw std::runtime_error("Cannot open '" + path + '\'');
+
+    std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+    if (data.compare(0, MAGIC_LENGTH, MAGIC) != 0 || data.size() <= MAGIC_LENGTH || data[MAGIC_LENGTH] != VERSION)
+        throw std::runtime_error('\'' + path + "' is not a session recording");
+
+    std::vector<TimedFrame> frames;
+    size_t offset = MAGIC_LENGTH + 1;
+    size_t sessionCount = 0;
+    double time = 0;
+    uint64_t value;
+
+    while (offset < data.size()) {
+        char type = data[offset++];
+
+        if (type == 'S') {
+            if (!getVarint(data, offset, value))
+                break;
+
+            ++sessionCount;
+        } else if (type == 'F') {
+            uint64_t length;
+
+            if (!getVarint(data, offset, value) || !getVarint(data, offset, length) || data.size() - offset < length)
+                break; // cut off by a crash, keep what came before
+
+            time += value / 1e9;
+            frames.push_back({time, data.substr(offset, length) + '\0'});
+            offset += length;
+        } else {
+            throw std::runtime_error('\'' + path + "' is corrupt at byte " + std::to_string(offset - 1));
+        }
+    }
+
+    if (sessions)
+        *sessions = sessionCount;
+
+    return frames;
+}
@@ -0,0 +1,80 @@
+#include "Slab.h"
+
+#include <cstdint>
+#include <cstring>
+
+
+Slab::Slab(size_t blockSize)
+    : _blockSize(blockSize)
+    , _blocks()
+    , _offset(blockSize)
+    , _used(0)
+    , _reserved(0)
+{
+}
+
+void* Slab::allocate(size_t size, size_t alignment)
+{
+    if (size == 0)
+        size = 1;
+
+    // oversized requests get a dedicated block, so the current block keeps filling up
+    if (size + alignment > _blockSize) {
+        std::unique_ptr<char[]> block(new char[size + alignment]);
+        char* p = block.get();
+        _reserved += size + alignment;
+        _used += size;
+
+        if (_blocks.empty())
+            _blocks.push_back(std::move(block));
+        else
+            _blocks.insert(_blocks.end() - 1, std::move(block));
+
+        uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+        return p + ((alignment - addr % alignment) % alignment);
+    }
+
+    char* base = _blocks.empty() ? nullptr : _blocks.back().get();
+    uintptr_t addr = reinterpret_cast<uintptr_t>(base) + _offset;
+    size_t padding = (alignment - addr % alignment) % alignment;
+
+    if (!base || _offset + padding + size > _blockSize) {
+        base = newBlock(_blockSize);
+        addr = reinterpret_cast<uintptr_t>(base);
+        padding = (alignment - addr % alignment) % alignment;
+    }
+
+    char* p = base + _offset + padding;
+    _offset += padding + size;
+    _used += size;
+    return p;
+}
+
+const char* Slab::copy(const char* data, size_t length)
+{
+    // never null, so callers can always build a std::string from the result
+    if (length == 0)
+        return "";
+
+    char* p = static_cast<char*>(allocate(length, 1));
+    std::memcpy(p, data, length);
+    return p;
+}
+
+size_t Slab::used() const
+{
+    return _used;
+}
+
+size_t Slab::reserved() const
+{
+    return _reserved;
+}
+
+char* Slab::newBlock(size_t size)
+{
+    _blocks.emplace_back(new char[size]);
+    _reserved += size;
+    _offset = 0;
+    return _blocks.back().get();
+}
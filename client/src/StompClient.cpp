@@ -1,19 +1,133 @@
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <unistd.h>
+#include <boost/asio.hpp>
 
+#include "ControlServer.h"
+#include "Log.h"
 #include "Parser.h"
+#include "ScriptRunner.h"
 #include "StompProtocol.h"
+#include "Trace.h"
 
 
-int main()
+// Reads commands from stdin on the protocol's io_context, so this one thread
+// serves both the user's commands and the broker's socket
+class Console
 {
-    StompProtocol p;
+public:
+    explicit Console(StompProtocol& protocol)
+        : _protocol(protocol)
+        , _input(protocol.ioContext(), ::dup(STDIN_FILENO))
+        , _buffer()
+    {
+    }
+
+    Console(const Console&) = delete;
+    Console& operator=(const Console&) = delete;
+
+    void run()
+    {
+        readLine();
+        _protocol.ioContext().run();
+    }
+
+private:
+    StompProtocol& _protocol;
+    boost::asio::posix::stream_descriptor _input;
+    boost::asio::streambuf _buffer;
+
+    void readLine()
+    {
+        boost::asio::async_read_until(_input, _buffer, '\n',
+            [this](const boost::system::error_code& ec, size_t length) {
+                if (ec) {
+                    // end of input quits, after any last line without a newline
+                    std::string rest(boost::asio::buffers_begin(_buffer.data()), boost::asio::buffers_end(_buffer.data()));
+                    Parser::parseCommand(rest, _protocol);
+
+                    Parser::whenDone([this]() {
+                        Parser::parseCommand("quit", _protocol);
+                        _protocol.ioContext().stop();
+                    });
+                    return;
+                }
+
+                auto data = boost::asio::buffers_begin(_buffer.data());
+                std::string line(data, data + length - 1);
+                _buffer.consume(length);
+
+                Parser::parseCommand(line, _protocol);
+
+                // the next line waits for a command still running, like a bench
+                Parser::whenDone([this]() {
+                    if (Parser::shouldQuit())
+                        _protocol.ioContext().stop();
+                    else
+                        readLine();
+                });
+            });
+    }
+};
+
+// --script <file> runs the file's commands without a prompt, as does input
+// that is not a terminal; both print each command's timing at the end.
+// --daemon <socket> keeps the session and takes commands from StompCtl.
+int main(int argc, char *argv[])
+{
+    const char* script = nullptr;
+    const char* daemon = nullptr;
 
-    while (!Parser::shouldQuit()) {
-        std::string line;
-        std::getline(std::cin, line);
-        Parser::parseCommand(line, p);
+    if (argc == 3 && std::strcmp(argv[1], "--script") == 0) {
+        script = argv[2];
+    } else if (argc == 3 && std::strcmp(argv[1], "--daemon") == 0) {
+        daemon = argv[2];
+    } else if (argc != 1) {
+        std::cerr << "Usage: " << argv[0] << " [--script <file> | --daemon <socket>]\n";
+        return 1;
     }
 
+    StompProtocol p(StompProtocol::defaultDecodeWorkers(), false);
+    Trace::setThreadName("main");
+
+    if (daemon != nullptr) {
+        try {
+            ControlServer server(p, daemon);
+            server.run();
+        } catch (std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (script == nullptr && ::isatty(STDIN_FILENO)) {
+        Console console(p);
+        console.run();
+        return 0;
+    }
+
+    ScriptRunner runner(p);
+
+    if (script != nullptr) {
+        std::ifstream in(script);
+
+        if (!in) {
+            std::cerr << "Could not open script '" << script << "'\n";
+            return 1;
+        }
+
+        runner.load(in);
+    } else {
+        runner.load(std::cin);
+    }
+
+    runner.run();
+    Log::flush();
+    runner.printTimings(std::cout);
+
     return 0;
 }
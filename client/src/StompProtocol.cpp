@@ -3,159 +3,244 @@
 #include <unordered_map>
 #include <sstream>
 #include <exception>
-#include <random>
 #include <thread>
-#include <iostream>
 #include <algorithm>
 
+#include "Latency.h"
+#include "Trace.h"
+#include "Probes.h"
+#include "Log.h"
 
-Frame::Frame(FrameType type, const std::unordered_map<std::string, std::string> &headers)
-    : Frame(type, headers, std::string())
-{
-}
 
-Frame::Frame(FrameType type, const std::unordered_map<std::string, std::string> &headers, const std::string &body)
-    : _type(type), _headers(headers), _body(body)
+static const size_t INBOUND_QUEUE_CAPACITY = 4096;
+static const size_t DECODER_QUEUE_CAPACITY = 1024;
+static const size_t MAX_DECODE_WORKERS = 8;
+static const int64_t RECEIPT_TIMEOUT_NS = 10000000000;
+static const std::chrono::milliseconds RECEIPT_CHECK_INTERVAL(1000);
+static const std::chrono::milliseconds RECONNECT_MIN_DELAY(100);
+static const std::chrono::milliseconds RECONNECT_MAX_DELAY(10000);
+
+const char* const StompProtocol::BENCH_HEADER = "x-bench-sent";
+const int StompProtocol::HEART_BEAT_TOLERANCE;
+
+StompProtocol::StompProtocol(size_t decodeWorkers, bool ownLoop)
+    : _ioContext()
+    , _transport()
+    , _outboundQueueBytes(0)
+    , _mtxSocket("socket")
+    , _pLastFrame()
+    , _readBuffer()
+    , _pendingReceipts()
+    , _mtxReceipts("receipts")
+    , _nextReceiptId(1)
+    , _reportReceipts(false)
+    , _loggedIn(false)
+    , _username()
+    , _session()
+    , _autoReconnect(false)
+    , _reconnecting(false)
+    , _outageStartNs(0)
+    , _reconnectDelay(RECONNECT_MIN_DELAY)
+    , _jitter(std::random_device()())
+    , _reconnectTimer(_ioContext)
+    , _heartBeat{0, 0}
+    , _heartBeatSend(0)
+    , _heartBeatReceive(0)
+    , _lastSendNs(0)
+    , _bytesSeen(0)
+    , _lastReceiveNs(0)
+    , _heartBeatTimer(_ioContext)
+    , _livenessTimer(_ioContext)
+    , _receiptTimer(_ioContext)
+    , _subscriptions()
+    , _mtxSubscriptions("subscriptions")
+    , _messageListener()
+    , _data()
+    , _inbound(INBOUND_QUEUE_CAPACITY)
+    , _inboundWaiter()
+    , _reading(false)
+    , _ownLoop(ownLoop)
+    , _generation(0)
+    , _reader()
+    , _decoder()
+    , _decoders(decodeWorkers, DECODER_QUEUE_CAPACITY, [this](const Frame& f) { handleMessage(f); })
+    , _recorder()
+    , _metrics()
 {
 }
 
-FrameType Frame::type() const
+StompProtocol::~StompProtocol()
 {
-    return _type;
+    _autoReconnect.store(false);
+    cancelReconnect();
+
+    // the loop ends the reads, and the decoder is done with the connection's state before it goes
+    boost::asio::post(_ioContext, [this]() { closeTransport(); });
+    stopReceiving();
+
+    closeTransport(); // no thread runs the loop any more
+    forgetConnection();
 }
 
-const std::string Frame::getHeader(const std::string &header) const
+size_t StompProtocol::defaultDecodeWorkers()
 {
-    auto it = _headers.find(header);
-    return (it != _headers.end()) ? it->second : std::string();
+    size_t cores = std::thread::hardware_concurrency();
+    return std::max<size_t>(1, std::min(cores, MAX_DECODE_WORKERS));
 }
 
-const std::string &Frame::body() const
+boost::asio::io_context& StompProtocol::ioContext()
 {
-    return _body;
+    return _ioContext;
 }
 
-std::string Frame::raw() const
+void StompProtocol::pump(std::chrono::milliseconds wait)
 {
-    std::string frame = getFrameName(_type) + '\n';
-    
-    for (auto header : _headers)
-        frame.append(header.first + ':' + header.second + '\n');
+    if (_ownLoop) {
+        std::this_thread::sleep_for(wait);
+        return;
+    }
 
-    frame.append(1, '\n');
-    frame.append(_body);
-    frame.append(1, '\0');
-    
-    return frame;
+    if (wait.count() == 0)
+        _ioContext.poll();
+    else
+        _ioContext.run_for(wait);
 }
 
-Frame Frame::parseFrame(const std::string &frame)
+// Safe from any thread: the transport is closed on the loop thread, which owns it
+void StompProtocol::closeConnection()
 {
-    std::istringstream stream(frame);
-    std::string line;
-
-    std::getline(stream, line);
+    unsigned generation = _generation.load();
 
-    FrameType type = getFrameType(line);
+    boost::asio::dispatch(_ioContext, [this, generation]() {
+        if (generation == _generation.load())
+            closeTransport();
+    });
 
-    std::unordered_map<std::string, std::string> headers;
+    forgetConnection();
+}
 
-    while (stream.peek() != '\n') {
-        std::getline(stream, line);
-        size_t colonPos = line.find(':');
-        headers[line.substr(0, colonPos)] = line.substr(colonPos + 1);
+void StompProtocol::closeTransport()
+{
+    if (_transport) {
+        std::lock_guard<ProfiledMutex> lck(_mtxSocket);
+        _transport->shutdown(); // ends the pending read
+        _transport->close();
     }
+}
 
-    std::getline(stream, line); // empty line
+void StompProtocol::forgetConnection()
+{
+    _loggedIn.store(false);
+    std::atomic_store(&_pLastFrame, std::shared_ptr<const Frame>());
 
-    std::string body;
+    {
+        std::lock_guard<ProfiledMutex> lck(_mtxReceipts);
+        _pendingReceipts.clear();
+    }
 
-    while (std::getline(stream, line))
-        body.append(line + '\n');
+    std::lock_guard<ProfiledMutex> lck(_mtxSubscriptions);
+    _subscriptions.clear();
+}
 
-    return Frame(type, headers, body);
+void StompProtocol::closeConnectionLogout()
+{
+    logout();
+    closeConnection();
 }
 
-StompProtocol::StompProtocol()
-    : _ioContext()
-    , _socket(_ioContext)
-    , _mtxSocket()
-    , _pLastFrame()
-    , _loggedIn(false)
-    , _username()
-    , _subscriptions()
-    , _data()
-    , _mtxData()
+std::vector<Event> StompProtocol::getReportsFrom(const std::string &channel, const std::string &user)
 {
+    return _data.reportsFrom(channel, user);
 }
 
-StompProtocol::~StompProtocol()
-{   
-    closeConnection();
+std::vector<ChannelMemory> StompProtocol::getMemoryUsage()
+{
+    return _data.memoryUsage();
 }
 
-void StompProtocol::closeConnection()
+QueueStats StompProtocol::getQueueStats() const
 {
-    boost::system::error_code ec;
-    _socket.close(ec);
-    _loggedIn.store(false);
-    _username.clear();
-    _subscriptions.clear();
-    _pLastFrame.reset();
+    return _inbound.stats();
 }
 
-void StompProtocol::closeConnectionLogout()
+std::vector<QueueStats> StompProtocol::getDecoderQueueStats() const
 {
-    logout();
-    closeConnection();
+    return _decoders.queueStats();
 }
 
-std::vector<Event> StompProtocol::getReportsFrom(const std::string &channel, const std::string &user)
+SessionRecorder& StompProtocol::recorder()
 {
-    std::lock_guard<std::mutex> lck(_mtxData);
-    auto channelIt = _data.find(channel);
+    return _recorder;
+}
 
-    if (channelIt == _data.end())
-        return std::vector<Event>();
+const ClientMetrics& StompProtocol::getMetrics() const
+{
+    return _metrics;
+}
 
-    auto channelData = channelIt->second;
-    auto userIt = channelData.find(user);
+size_t StompProtocol::getPendingReceipts()
+{
+    std::lock_guard<ProfiledMutex> lck(_mtxReceipts);
+    return _pendingReceipts.size();
+}
 
-    if (userIt == channelData.end())
-        return std::vector<Event>();
+// The transport belongs to the loop thread, so the value is read there; a
+// caller on another thread, like the metrics exporter, gets the previous read
+size_t StompProtocol::getOutboundQueueBytes()
+{
+    boost::asio::dispatch(_ioContext, [this]() {
+        size_t bytes = (_loggedIn.load() && _transport) ? _transport->outboundQueueBytes() : 0;
+        _outboundQueueBytes.store(bytes, std::memory_order_relaxed);
+    });
 
-    return userIt->second;
+    return _outboundQueueBytes.load(std::memory_order_relaxed);
 }
 
-void StompProtocol::login(const std::string &host, short port, const std::string &username, const std::string &password)
+void StompProtocol::login(const std::string &address, const std::string &username, const std::string &password)
 {
     if (_loggedIn.load())
         throw std::logic_error("Already logged in");
 
-    if (!_socket.is_open()) {
-        boost::asio::ip::tcp::endpoint ep(
-		    boost::asio::ip::address::from_string(host),
-		    port
-        );
+    if (_reconnecting.load())
+        throw std::logic_error("Reconnecting to the broker, 'logout' gives up");
+
+    _session.username = username;
+    _session.password = password;
+
+    if (!_transport || !_transport->isOpen()) {
+        stopReceiving(); // left over from the previous connection
+
+        if (!_transport || _transport->address() != address)
+            _transport = Transport::create(_ioContext, address);
 
         boost::system::error_code ec;
-        _socket.connect(ep, ec);
+        _transport->connect(ec);
 
         if (ec) {
-            std::cerr << "Server is not running\n";
-            _socket.close();
+            Log::error("Server is not running");
+            _transport->close();
             return;
         }
+
+        ClientMetrics::add(_metrics.connects);
     }
 
-    send(Frame::Connect(username, password));
+    // ends when CONNECTED is handled
+    Trace::asyncBegin("session", "login", _metrics.connects.load());
+    send(Frame::Connect(username, password, _heartBeat));
 
-    std::thread reader(&StompProtocol::receiveMessages, this);
-    reader.detach();
+    if (!_reading.load())
+        startReceiving();
 }
 
 void StompProtocol::logout()
 {
+    if (_reconnecting.load()) {
+        cancelReconnect();
+        Log::info("Stopped reconnecting");
+        return;
+    }
+
     if (!_loggedIn.load())
         throw std::logic_error("Not logged in");
     
@@ -167,7 +252,7 @@ void StompProtocol::subscribe(const std::string &topic)
     if (!_loggedIn.load())
         throw std::logic_error("Not logged in");
 
-    if (_subscriptions.find(topic) != _subscriptions.end())
+    if (isSubscribed(topic))
         throw std::invalid_argument("Already subscribed to '" + topic + '\'');
 
     send(Frame::Subscribe(topic, generateSubscriptionID(topic), generateReceiptID()));
@@ -178,237 +263,672 @@ void StompProtocol::unsubscribe(const std::string &topic)
     if (!_loggedIn.load())
         throw std::logic_error("Not logged in");
 
-    auto it = _subscriptions.find(topic);
-    
-    if (it == _subscriptions.end())
-        throw std::invalid_argument("Not subscribed to '" + topic + '\'');
+    size_t id;
+
+    {
+        std::lock_guard<ProfiledMutex> lck(_mtxSubscriptions);
+        auto it = _subscriptions.find(topic);
+
+        if (it == _subscriptions.end())
+            throw std::invalid_argument("Not subscribed to '" + topic + '\'');
 
-    send(Frame::Unsubscribe(it->second, generateReceiptID()));
-    _subscriptions.erase(it);
-    std::cout << "Exited '" << topic << "'\n";
+        id = it->second;
+        _subscriptions.erase(it);
+    }
+
+    send(Frame::Unsubscribe(id, generateReceiptID()));
+    Log::info("Exited '" + topic + '\'');
 }
 
 void StompProtocol::report(Event &event)
+{
+    report(event, {});
+}
+
+void StompProtocol::report(Event &event, const std::unordered_map<std::string, std::string> &headers)
 {
     if (!_loggedIn.load())
         throw std::logic_error("Not logged in");
 
-    if (_subscriptions.find(event.get_channel_name()) == _subscriptions.end())
+    if (!isSubscribed(event.get_channel_name()))
         throw std::invalid_argument("Not subscribed to '" + event.get_channel_name() + '\'');
 
     event.setEventOwnerUser(_username);
-    send(Frame::Send(event));
+
+    // while tracing, a receipt shows when the broker has taken each report
+    bool receipt = _reportReceipts.load() || Trace::enabled();
+    Frame frame = receipt ? Frame::Send(event, generateReceiptID()) : Frame::Send(event);
+
+    for (const auto& header : headers)
+        frame.setHeader(header.first, header.second);
+
+    send(std::move(frame));
+}
+
+void StompProtocol::setAutoReconnect(bool on)
+{
+    _autoReconnect.store(on);
+
+    if (!on && _reconnecting.load())
+        cancelReconnect();
+}
+
+bool StompProtocol::autoReconnect() const
+{
+    return _autoReconnect.load();
+}
+
+bool StompProtocol::isReconnecting() const
+{
+    return _reconnecting.load();
+}
+
+void StompProtocol::setHeartBeat(HeartBeat heartBeat)
+{
+    _heartBeat = heartBeat;
+}
+
+HeartBeat StompProtocol::heartBeat() const
+{
+    return _heartBeat;
+}
+
+HeartBeat StompProtocol::negotiatedHeartBeat() const
+{
+    return {_heartBeatSend.load(), _heartBeatReceive.load()};
+}
+
+bool StompProtocol::isLoggedIn() const
+{
+    return _loggedIn.load();
+}
+
+bool StompProtocol::isReceiving() const
+{
+    return _reading.load();
+}
+
+bool StompProtocol::isSubscribed(const std::string &topic)
+{
+    std::lock_guard<ProfiledMutex> lck(_mtxSubscriptions);
+    return _subscriptions.find(topic) != _subscriptions.end();
+}
+
+void StompProtocol::setReportReceipts(bool on)
+{
+    _reportReceipts.store(on);
 }
 
-void StompProtocol::send(const Frame &frame)
+int StompProtocol::nextReceiptId() const
 {
+    return _nextReceiptId.load();
+}
+
+bool StompProtocol::isReceiptPending(int from, int to)
+{
+    std::lock_guard<ProfiledMutex> lck(_mtxReceipts);
+
+    for (const auto& pending : _pendingReceipts) {
+        int id = std::stoi(pending.first);
+        if (id >= from && id < to) return true;
+    }
+
+    return false;
+}
+
+bool StompProtocol::isDecodeIdle() const
+{
+    return _inbound.empty() && _decoders.idle();
+}
+
+void StompProtocol::setMessageListener(MessageListener listener)
+{
+    std::shared_ptr<const MessageListener> pListener;
+    if (listener) pListener = std::make_shared<const MessageListener>(std::move(listener));
+
+    std::atomic_store(&_messageListener, pListener);
+}
+
+void StompProtocol::send(Frame frame)
+{
+    // published before sending: the broker's reply can be handled before send() returns
+    std::shared_ptr<const Frame> pFrame = std::make_shared<const Frame>(std::move(frame));
+    std::atomic_store(&_pLastFrame, pFrame);
+
+    const char* name = Frame::getFrameName(pFrame->type()).c_str();
+    TRACE_SCOPE("frame", name);
+
+    const std::string& receipt = pFrame->getHeader("receipt");
+
+    if (!receipt.empty()) {
+        Trace::asyncBegin("receipt", name, std::stoull(receipt));
+
+        std::lock_guard<ProfiledMutex> lck(_mtxReceipts);
+        _pendingReceipts[receipt] = {pFrame, Latency::now()};
+    }
+
+    std::string raw = LATENCY_TIMED(FRAME_ENCODE, pFrame->raw());
     boost::system::error_code ec;
-    _socket.send(boost::asio::buffer(frame.raw()), 0, ec);
+
+    if (!_transport) {
+        ec = boost::asio::error::not_connected;
+    } else {
+        std::lock_guard<ProfiledMutex> lck(_mtxSocket);
+        LATENCY_SCOPE(SOCKET_WRITE);
+        _transport->send(boost::asio::buffer(raw), ec);
+    }
 
     if (ec) {
-        std::cerr << "Socket Error: " << ec.message() << '\n';
+        Log::error("Socket Error: " + ec.message());
         closeConnection();
+        return;
     }
 
-    _pLastFrame.reset(new Frame(frame));
+    _lastSendNs.store(Latency::now(), std::memory_order_relaxed);
+    ClientMetrics::add(_metrics.framesOut[static_cast<size_t>(pFrame->type())]);
+    ClientMetrics::add(_metrics.bytesOut, raw.length());
+    STOMP_PROBE2(frame__sent, name, raw.length());
 }
 
-std::string StompProtocol::readFrame()
+std::string StompProtocol::takeFrame(size_t length)
 {
-    std::string frame;
-    char c;
+    LATENCY_SCOPE(SOCKET_READ);
+    auto data = boost::asio::buffers_begin(_readBuffer.data());
+    auto end = data + length - 1;
 
-    do {
-        _socket.read_some(boost::asio::buffer(&c, 1));
-        frame.append(1, c);
-    } while (c != '\0');
+    // EOLs before a frame are the broker's heart-beats
+    while (data != end && (*data == '\n' || *data == '\r'))
+        ++data;
+
+    std::string frame(data, end);
+    _readBuffer.consume(length);
 
-    frame.pop_back();
     return frame;
 }
 
-void StompProtocol::receiveMessages()
+void StompProtocol::startReceiving()
+{
+    unsigned generation = ++_generation;
+
+    _readBuffer.consume(_readBuffer.size()); // left over from the previous connection
+    _reading.store(true);
+    _decoder = std::thread(&StompProtocol::decodeMessages, this);
+    receiveFrames(generation);
+
+    // until CONNECTED agrees on intervals, the broker has the receive interval asked for to answer
+    _heartBeatSend.store(0);
+    _heartBeatReceive.store(0);
+    startHeartBeats(generation, 0, _heartBeat.receive);
+    checkReceipts(generation);
+
+    // a reconnect runs on the reader thread, which keeps serving the new connection
+    if (_ownLoop && !_reader.joinable()) {
+        _ioContext.restart();
+        _reader = std::thread([this]() {
+            Trace::setThreadName("reader");
+            _ioContext.run(); // returns once the connection's reads have ended
+        });
+    }
+}
+
+void StompProtocol::stopReceiving()
 {
-    do {
-        try {
-            Frame f = Frame::parseFrame(readFrame());
+    if (_reader.joinable())
+        _reader.join();
+    else
+        _reading.store(false); // the socket is closed; the loop's owner may never run the aborted read
 
-            switch (f.type()) {
-                case FrameType::CONNECTED:
-                    handleConnected(f);
-                    break;
+    _inboundWaiter.notify();
 
-                case FrameType::RECEIPT:
-                    handleReceipt(f);
-                    break;
+    if (_decoder.joinable()) _decoder.join();
+}
+
+// Socket stage: only reads frames off the socket, so decoding or a busy
+// channel lock never delays reading from the broker
+void StompProtocol::receiveFrames(unsigned generation)
+{
+    _transport->asyncReadUntil(_readBuffer, '\0',
+        [this, generation](const boost::system::error_code& ec, size_t length) {
+            if (generation != _generation.load())
+                return;
+
+            if (ec) {
+                std::shared_ptr<const Frame> pLastFrame = std::atomic_load(&_pLastFrame);
+                bool disconnecting = pLastFrame && pLastFrame->type() == FrameType::DISCONNECT;
+
+                bool lost = (_loggedIn.load() || _reconnecting.load())
+                    && !disconnecting && ec != boost::asio::error::operation_aborted;
 
-                case FrameType::MESSAGE:
-                    handleMessage(f);
-                    break;
+                if (lost)
+                    Log::error("read_until: " + ec.message());
 
-                case FrameType::ERROR:
-                    std::cout << f.getHeader("message") << '\n';
-                    break;
+                // the rest of closeConnection waits for the decoder, which may
+                // still hold frames that need this connection's state, like
+                // the RECEIPT of a DISCONNECT
+                {
+                    std::lock_guard<ProfiledMutex> lck(_mtxSocket); // a send may be under way
+                    _transport->close();
+                }
 
-                default:
-                    std::cerr << "Unhandled frame received: " << (int)f.type() << '\n';
-                    break;
+                _heartBeatTimer.cancel();
+                _livenessTimer.cancel();
+                _receiptTimer.cancel();
+
+                if (lost && _autoReconnect.load())
+                    connectionLost(); // before the decoder may forget the subscriptions
+
+                _reading.store(false);
+                _inboundWaiter.notify();
+                return;
             }
-        } catch (boost::system::system_error& e) {
-            std::cerr << e.what() << '\n';
-            closeConnection();
-        } catch (std::exception& e) {
-            std::cerr << e.what() << '\n';
-        }
-    } while (_loggedIn.load());
+
+            ClientMetrics::add(_metrics.bytesIn, length);
+            std::string frame = takeFrame(length);
+            _recorder.record(frame);
+
+            while (!_inbound.tryPush(std::move(frame)))
+                std::this_thread::yield();
+
+            _inboundWaiter.notify();
+
+            receiveFrames(generation);
+        });
 }
 
-void StompProtocol::handleConnected(Frame f)
+void StompProtocol::connectionLost()
 {
-    std::cout << "Login successful\n";
-    _loggedIn.store(true);
-    _username = _pLastFrame->getHeader("login");
+    if (!_reconnecting.exchange(true)) {
+        _outageStartNs.store(Latency::now());
+        _reconnectDelay = RECONNECT_MIN_DELAY;
+
+        std::lock_guard<ProfiledMutex> lck(_mtxSubscriptions);
+        _session.topics.clear();
+        for (const auto& subscription : _subscriptions)
+            _session.topics.push_back(subscription.first);
+
+        Log::warn("Connection lost, reconnecting");
+    }
+
+    scheduleReconnect();
 }
 
-void StompProtocol::handleReceipt(Frame f)
+// Waits a random time between half and all of the current delay, so clients
+// dropped together do not all come back at once
+void StompProtocol::scheduleReconnect()
 {
-    if (f.getHeader("receipt-id") != _pLastFrame->getHeader("receipt"))
-        return;
+    std::uniform_int_distribution<int64_t> jitter(0, _reconnectDelay.count() / 2);
+    std::chrono::milliseconds delay(_reconnectDelay.count() - jitter(_jitter));
+    _reconnectDelay = std::min(_reconnectDelay * 2, RECONNECT_MAX_DELAY);
 
-    std::string channel;
+    _reconnectTimer.expires_after(delay);
+    _reconnectTimer.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec && _reconnecting.load())
+            reconnect();
+    });
+}
 
-    switch (_pLastFrame->type()) {
-        case FrameType::DISCONNECT:
-            std::cout << "Logout successful\n";
-            closeConnection();
-            break;
+void StompProtocol::reconnect()
+{
+    // the decoder forgets the lost connection on its way out
+    if (_decoder.joinable()) _decoder.join();
 
-        case FrameType::SUBSCRIBE:
-            channel = _pLastFrame->getHeader("destination");
-            std::cout << "Subscribed to '" << channel << "'\n";
-            _subscriptions[channel] = std::stoi(_pLastFrame->getHeader("id"));
-            break;
+    _transport->asyncConnect([this](const boost::system::error_code& ec) {
+        if (!_reconnecting.load() || ec) {
+            {
+                std::lock_guard<ProfiledMutex> lck(_mtxSocket);
+                _transport->close();
+            }
 
-        case FrameType::UNSUBSCRIBE:
-            // already handled
-            break;
+            if (_reconnecting.load()) {
+                Log::debug("Reconnect failed: " + ec.message());
+                scheduleReconnect();
+            }
+            return;
+        }
 
-        default:
-            std::cout << "Received receipt of unknown purpose\n";
-            break;
-    }
+        ClientMetrics::add(_metrics.connects);
+
+        // pipelined: the SUBSCRIBEs do not wait for CONNECTED
+        Trace::asyncBegin("session", "login", _metrics.connects.load());
+        send(Frame::Connect(_session.username, _session.password, _heartBeat));
+
+        for (const std::string& topic : _session.topics)
+            send(Frame::Subscribe(topic, generateSubscriptionID(topic), generateReceiptID()));
+
+        startReceiving();
+    });
 }
 
-void StompProtocol::handleMessage(Frame f)
+// Safe from any thread; the timer and a connect in flight belong to the loop
+void StompProtocol::cancelReconnect()
 {
-    Event e(f.body());
-    std::string channelName = f.getHeader("destination").substr(1);
-    e.setChannelName(channelName);
-    std::lock_guard<std::mutex> lck(_mtxData);
-    _data[channelName][e.getEventOwnerUser()].push_back(e);
+    _reconnecting.store(false);
+
+    boost::asio::dispatch(_ioContext, [this]() {
+        _reconnectTimer.cancel();
+
+        if (_transport && !_loggedIn.load() && !_reading.load()) {
+            std::lock_guard<ProfiledMutex> lck(_mtxSocket);
+            _transport->close();
+        }
+    });
 }
 
-const std::string& Frame::getFrameName(FrameType t)
+// Runs on the loop thread, for the connection of the given generation
+void StompProtocol::startHeartBeats(unsigned generation, uint32_t send, uint32_t receive)
 {
-    static const std::string names[] = {
-        "CONNECT",
-        "SEND",
-        "SUBSCRIBE",
-        "UNSUBSCRIBE",
-        "DISCONNECT",
-        "CONNECTED",
-        "MESSAGE",
-        "RECEIPT",
-        "ERROR"
-    };
+    if (generation != _generation.load() || !_reading.load())
+        return;
 
-    return names[static_cast<size_t>(t)];
+    _heartBeatTimer.cancel();
+    _livenessTimer.cancel();
+
+    if (send != 0)
+        sendHeartBeats(generation, send);
+
+    if (receive != 0) {
+        _bytesSeen = _metrics.bytesIn.load(std::memory_order_relaxed) + _readBuffer.size();
+        _lastReceiveNs = Latency::now();
+        checkLiveness(generation, receive);
+    }
 }
 
-FrameType Frame::getFrameType(const std::string &name)
+// An EOL whenever nothing else went out for half the interval
+void StompProtocol::sendHeartBeats(unsigned generation, uint32_t interval)
 {
-    static const std::unordered_map<std::string, FrameType> types = {
-        {"CONNECT", FrameType::CONNECT},
-        {"SEND", FrameType::SEND},
-        {"SUBSCRIBE", FrameType::SUBSCRIBE},
-        {"UNSUBSCRIBE", FrameType::UNSUBSCRIBE},
-        {"DISCONNECT", FrameType::DISCONNECT},
-        {"CONNECTED", FrameType::CONNECTED},
-        {"MESSAGE", FrameType::MESSAGE},
-        {"RECEIPT", FrameType::RECEIPT},
-        {"ERROR", FrameType::ERROR}
-    };
+    _heartBeatTimer.expires_after(std::chrono::milliseconds(std::max<uint32_t>(interval / 2, 1)));
+    _heartBeatTimer.async_wait([this, generation, interval](const boost::system::error_code& ec) {
+        if (ec || generation != _generation.load() || !_reading.load())
+            return;
+
+        int64_t now = Latency::now();
 
-    auto it = types.find(name);
+        if (now - _lastSendNs.load(std::memory_order_relaxed) >= interval * 500000LL) {
+            boost::system::error_code writeError;
 
-    if (it == types.end())
-        throw std::invalid_argument('\'' + name + "' is not a frame type");
+            {
+                std::lock_guard<ProfiledMutex> lck(_mtxSocket);
+                _transport->send(boost::asio::buffer("\n", 1), writeError);
+            }
+
+            if (writeError)
+                return; // the read side notices the connection is gone
+
+            _lastSendNs.store(now, std::memory_order_relaxed);
+            ClientMetrics::add(_metrics.bytesOut);
+        }
 
-    return it->second;
+        sendHeartBeats(generation, interval);
+    });
 }
 
-Frame Frame::Connect(const std::string &user, const std::string &password)
+// Any byte counts, a frame still being read included
+void StompProtocol::checkLiveness(unsigned generation, uint32_t interval)
 {
-    std::unordered_map<std::string, std::string> headers = {
-        {"login", user},
-        {"passcode", password},
-        {"accept-version", "1.2"},
-        {"host", "stomp.cs.bgu.ac.il"}
-    };
+    _livenessTimer.expires_after(std::chrono::milliseconds(std::max<uint32_t>(interval / 2, 1)));
+    _livenessTimer.async_wait([this, generation, interval](const boost::system::error_code& ec) {
+        if (ec || generation != _generation.load() || !_reading.load())
+            return;
+
+        uint64_t seen = _metrics.bytesIn.load(std::memory_order_relaxed) + _readBuffer.size();
+        int64_t now = Latency::now();
+
+        if (seen != _bytesSeen) {
+            _bytesSeen = seen;
+            _lastReceiveNs = now;
+        } else if (now - _lastReceiveNs > static_cast<int64_t>(interval) * HEART_BEAT_TOLERANCE * 1000000) {
+            ClientMetrics::add(_metrics.heartBeatTimeouts);
+            Log::warn("Nothing from the broker for " + std::to_string((now - _lastReceiveNs) / 1000000)
+                      + " ms, dropping the connection");
 
-    return Frame(FrameType::CONNECT, headers);
+            // ends the pending read like a broker hanging up would
+            std::lock_guard<ProfiledMutex> lck(_mtxSocket);
+            _transport->shutdown();
+            return;
+        }
+
+        checkLiveness(generation, interval);
+    });
 }
 
-Frame Frame::Disconnect(int receipt)
+// On the loop, so a metrics scrape only reads the count
+void StompProtocol::checkReceipts(unsigned generation)
 {
-    return Frame(
-        FrameType::DISCONNECT,
-        {{"receipt", std::to_string(receipt)}}
-    );
+    _receiptTimer.expires_after(RECEIPT_CHECK_INTERVAL);
+    _receiptTimer.async_wait([this, generation](const boost::system::error_code& ec) {
+        if (ec || generation != _generation.load() || !_reading.load())
+            return;
+
+        expireReceipts();
+        checkReceipts(generation);
+    });
 }
 
-Frame Frame::Subscribe(const std::string &topic, int id, int receipt)
+void StompProtocol::expireReceipts()
 {
-    std::unordered_map<std::string, std::string> headers = {
-        {"destination", topic},
-        {"id", std::to_string(id)},
-        {"receipt", std::to_string(receipt)}
-    };
+    int64_t now = Latency::now();
+    std::lock_guard<ProfiledMutex> lck(_mtxReceipts);
 
-    return Frame(FrameType::SUBSCRIBE, headers);
+    for (auto& pending : _pendingReceipts) {
+        if (!pending.second.timedOut && now - pending.second.sentNs > RECEIPT_TIMEOUT_NS) {
+            pending.second.timedOut = true;
+            ClientMetrics::add(_metrics.receiptTimeouts);
+        }
+    }
 }
 
-Frame Frame::Unsubscribe(int id, int receipt)
+// Decode/store stage: drains what the socket stage queued. MESSAGE frames
+// go to the decoder pool; everything else is handled here, in order.
+void StompProtocol::decodeMessages()
 {
-    return Frame(
-        FrameType::UNSUBSCRIBE,
-        {{"id", std::to_string(id)}, {"receipt", std::to_string(receipt)}}
-    );
+    std::string frame;
+    size_t idle = 0;
+    Trace::setThreadName("decoder");
+    _decoders.start();
+
+    while (true) {
+        if (_inbound.tryPop(frame)) {
+            idle = 0;
+
+            try {
+                size_t length = frame.length();
+
+                if (DecoderPool::messageDestination(frame).data) {
+                    ClientMetrics::add(_metrics.framesIn[static_cast<size_t>(FrameType::MESSAGE)]);
+                    STOMP_PROBE2(frame__received, Frame::getFrameName(FrameType::MESSAGE).c_str(), length);
+                    _decoders.submit(std::move(frame));
+                } else {
+                    Frame f = LATENCY_TIMED(FRAME_PARSE, Frame::parseFrame(std::move(frame)));
+                    ClientMetrics::add(_metrics.framesIn[static_cast<size_t>(f.type())]);
+                    STOMP_PROBE2(frame__received, Frame::getFrameName(f.type()).c_str(), length);
+                    dispatch(f);
+                }
+            } catch (std::exception& e) {
+                Log::error(e.what());
+            }
+
+            continue;
+        }
+
+        if (!_reading.load() && _inbound.empty())
+            break;
+
+        _inboundWaiter.backoff(++idle, [this]() { return !_inbound.empty() || !_reading.load(); });
+    }
+
+    // the read side has closed the transport already
+    _decoders.stop();
+    forgetConnection();
 }
 
-Frame Frame::Send(const Event &event, int receipt)
+void StompProtocol::dispatch(const Frame &f)
 {
-    return Frame(
-        FrameType::SEND,
-        {{"receipt", std::to_string(receipt)}, {"destination", '/' + event.get_channel_name()}},
-        event.toString()
-    );
+    switch (f.type()) {
+        case FrameType::CONNECTED:
+            handleConnected(f);
+            break;
+
+        case FrameType::RECEIPT:
+            handleReceipt(f);
+            break;
+
+        case FrameType::MESSAGE:
+            handleMessage(f);
+            break;
+
+        case FrameType::ERROR:
+            Log::error(f.getHeader("message"));
+
+            // refused: trying again would only be refused again
+            if (_reconnecting.load())
+                cancelReconnect();
+            break;
+
+        default:
+            Log::warn("Unhandled frame received: " + Frame::getFrameName(f.type()));
+            break;
+    }
 }
 
-Frame Frame::Send(const Event &event)
+void StompProtocol::handleConnected(const Frame &f)
 {
-    return Frame(
-        FrameType::SEND,
-        {{"destination", '/' + event.get_channel_name()}},
-        event.toString()
-    );
+    // before any state changes: a broker's malformed header turns heart-beating
+    // off, rather than leaving a reconnect half done
+    HeartBeat broker = {0, 0};
+
+    try {
+        broker = HeartBeat::parse(f.getHeader("heart-beat"));
+    } catch (std::exception& e) {
+        Log::warn(std::string(e.what()) + " from the broker, not heart-beating");
+    }
+
+    std::shared_ptr<const Frame> pLastFrame = std::atomic_load(&_pLastFrame);
+
+    Trace::asyncEnd("session", "login", _metrics.connects.load());
+    Log::info("Login successful");
+
+    // a reconnect's SUBSCRIBEs follow its CONNECT, so the last frame may not be it
+    std::string username = _reconnecting.load() ? _session.username
+        : (pLastFrame ? pLastFrame->getHeader("login") : std::string());
+
+    uint32_t send = HeartBeat::interval(_heartBeat.send, broker.receive);
+    uint32_t receive = HeartBeat::interval(broker.send, _heartBeat.receive);
+    unsigned generation = _generation.load();
+
+    // the username is the loop's, like the transport; logged in once it is set
+    boost::asio::post(_ioContext, [this, generation, username, send, receive]() {
+        if (generation != _generation.load() || !_reading.load())
+            return;
+
+        _username = username;
+        _loggedIn.store(true);
+        _heartBeatSend.store(send);
+        _heartBeatReceive.store(receive);
+        startHeartBeats(generation, send, receive);
+    });
+
+    if (_reconnecting.exchange(false)) {
+        ClientMetrics::add(_metrics.reconnects);
+        uint64_t outage = Latency::now() - _outageStartNs.load();
+        ClientMetrics::add(_metrics.outageNs, outage);
+        _metrics.lastOutageNs.store(outage, std::memory_order_relaxed);
+
+        Log::info("Reconnected after " + std::to_string(outage / 1000000) + " ms, rejoining "
+                  + std::to_string(_session.topics.size()) + " channel(s)");
+    }
+}
+
+// The receipt stays pending until it has been handled, so a caller waiting
+// on it sees what it did, like a subscription recorded
+void StompProtocol::handleReceipt(const Frame &f)
+{
+    const std::string& receiptId = f.getHeader("receipt-id");
+    PendingReceipt pending;
+
+    {
+        std::lock_guard<ProfiledMutex> lck(_mtxReceipts);
+        auto it = _pendingReceipts.find(receiptId);
+
+        if (it == _pendingReceipts.end())
+            return;
+
+        pending = it->second;
+    }
+
+    const char* name = Frame::getFrameName(pending.frame->type()).c_str();
+    int64_t roundTrip = Latency::now() - pending.sentNs;
+
+    LATENCY_RECORD(RECEIPT_ROUND_TRIP, roundTrip);
+
+    if (pending.timedOut)
+        Log::warn("Receipt " + receiptId + " came after " + std::to_string(roundTrip / 1000000) + " ms");
+    Trace::asyncEnd("receipt", name, std::stoull(receiptId));
+    STOMP_PROBE3(receipt__matched, receiptId.c_str(), name, roundTrip);
+
+    std::string channel;
+
+    switch (pending.frame->type()) {
+        case FrameType::DISCONNECT:
+            Log::info("Logout successful");
+            closeConnection();
+            break;
+
+        case FrameType::SUBSCRIBE:
+            channel = pending.frame->getHeader("destination");
+            Log::info("Subscribed to '" + channel + '\'');
+            {
+                std::lock_guard<ProfiledMutex> lck(_mtxSubscriptions);
+                _subscriptions[channel] = std::stoi(pending.frame->getHeader("id"));
+            }
+            break;
+
+        case FrameType::UNSUBSCRIBE:
+            // already handled
+            break;
+
+        case FrameType::SEND:
+            // only asked for while tracing or on request
+            break;
+
+        default:
+            Log::warn("Received receipt of unknown purpose");
+            break;
+    }
+
+    std::lock_guard<ProfiledMutex> lck(_mtxReceipts);
+    _pendingReceipts.erase(receiptId); // gone already if the connection was closed
+}
+
+void StompProtocol::handleMessage(const Frame &f)
+{
+    std::shared_ptr<const MessageListener> pListener = std::atomic_load(&_messageListener);
+
+    if (pListener && (*pListener)(f))
+        return;
+
+    if (!f.getHeader(BENCH_HEADER).empty())
+        return;
+
+    // decoded straight from the frame body into the store
+    EventFields fields;
+    {
+        TRACE_SCOPE("message", "decode");
+        fields = LATENCY_TIMED(EVENT_DECODE, EventFields::parse(f.body()));
+    }
+    std::string channelName = f.getHeader("destination").substr(1);
+
+    {
+        TRACE_SCOPE("message", "store");
+        LATENCY_SCOPE(STORE_INSERT);
+        _data.insert(channelName, fields);
+    }
+
+    STOMP_PROBE3(message__stored, channelName.c_str(), fields.user.data, fields.user.length);
 }
 
 int StompProtocol::generateReceiptID()
 {
-    std::default_random_engine generator;
-    std::uniform_int_distribution<int> distribution(10, 99);
-    return distribution(generator);
+    return _nextReceiptId.fetch_add(1);
 }
 
 size_t StompProtocol::generateSubscriptionID(const std::string &topic)
@@ -0,0 +1,553 @@
+#include "StubBroker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+
+
+static const size_t READ_BUFFER_SIZE = 64 * 1024;
+static const int HEART_BEAT_TOLERANCE = 2; // silent intervals before a client is dropped
+
+
+StubBroker::StubBroker()
+    : _clients()
+    , _topics()
+    , _passcodes()
+    , _activeUsers()
+    , _heartBeat{0, 0}
+    , _nextMessageId(0)
+    , _framesReceived(0)
+    , _messagesDelivered(0)
+{
+}
+
+void StubBroker::setHeartBeat(HeartBeat heartBeat)
+{
+    _heartBeat = heartBeat;
+}
+
+void StubBroker::receive(Session &session, const Frame &frame)
+{
+    ++_framesReceived;
+
+    if (frame.type() == FrameType::CONNECT) {
+        connect(session, frame);
+        return;
+    }
+
+    auto it = _clients.find(&session);
+
+    if (it == _clients.end()) {
+        error(session, "Not logged in");
+        return;
+    }
+
+    switch (frame.type()) {
+        case FrameType::SEND:
+            send(session, it->second, frame);
+            break;
+
+        case FrameType::SUBSCRIBE:
+            subscribe(session, it->second, frame);
+            break;
+
+        case FrameType::UNSUBSCRIBE:
+            unsubscribe(session, it->second, frame);
+            break;
+
+        case FrameType::DISCONNECT:
+            disconnect(session, frame);
+            break;
+
+        default:
+            error(session, "Unsupported frame type: " + Frame::getFrameName(frame.type()));
+            break;
+    }
+}
+
+void StubBroker::disconnected(Session &session)
+{
+    auto it = _clients.find(&session);
+
+    if (it == _clients.end())
+        return;
+
+    for (const auto& subscription : it->second.subscriptions)
+        removeSubscription(session, subscription.second, subscription.first);
+
+    _activeUsers.erase(it->second.user);
+    _clients.erase(it);
+}
+
+uint64_t StubBroker::framesReceived() const
+{
+    return _framesReceived;
+}
+
+uint64_t StubBroker::messagesDelivered() const
+{
+    return _messagesDelivered;
+}
+
+void StubBroker::connect(Session &session, const Frame &frame)
+{
+    const std::string& user = frame.getHeader("login");
+    const std::string& passcode = frame.getHeader("passcode");
+
+    if (user.empty() || frame.headers().find("passcode") == frame.headers().end()) {
+        error(session, "Missing 'login' or 'passcode' header in CONNECT frame");
+        return;
+    }
+
+    if (frame.getHeader("accept-version").find("1.2") == std::string::npos) {
+        error(session, "Invalid or missing 'accept-version' header in CONNECT frame");
+        return;
+    }
+
+    HeartBeat client = {0, 0};
+
+    try {
+        client = HeartBeat::parse(frame.getHeader("heart-beat"));
+    } catch (std::exception&) {
+        error(session, "Invalid 'heart-beat' header in CONNECT frame");
+        return;
+    }
+
+    if (_clients.find(&session) != _clients.end() || _activeUsers.find(user) != _activeUsers.end()) {
+        error(session, "User already logged in");
+        return;
+    }
+
+    auto known = _passcodes.find(user);
+
+    if (known == _passcodes.end())
+        _passcodes.emplace(user, passcode);
+    else if (known->second != passcode) {
+        error(session, "Incorrect passcode");
+        return;
+    }
+
+    _clients[&session].user = user;
+    _activeUsers[user] = &session;
+    session.deliver(Frame::Connected("1.2", _heartBeat).raw(), nullptr);
+    session.heartBeat(HeartBeat::interval(_heartBeat.send, client.receive), HeartBeat::interval(client.send, _heartBeat.receive));
+}
+
+void StubBroker::send(Session &session, Client &client, const Frame &frame)
+{
+    std::string topic = topicName(frame.getHeader("destination"));
+
+    if (topic.empty()) {
+        error(session, "Missing or empty 'destination' header");
+        return;
+    }
+
+    auto subscribed = std::find_if(client.subscriptions.begin(), client.subscriptions.end(),
+        [&topic](const std::pair<const std::string, std::string>& s) { return s.second == topic; });
+
+    if (subscribed == client.subscriptions.end()) {
+        error(session, "Not subscribed to the given topic");
+        return;
+    }
+
+    // everything after the per-subscriber headers is encoded once and shared
+    std::shared_ptr<std::string> shared = std::make_shared<std::string>();
+    shared->reserve(frame.body().length() + topic.length() + 64);
+    shared->append("destination:/").append(topic).append(1, '\n');
+
+    for (const auto& header : frame.headers()) {
+        if (header.first != "destination" && header.first != "receipt")
+            shared->append(header.first).append(1, ':').append(header.second).append(1, '\n');
+    }
+
+    shared->append(1, '\n').append(frame.body()).append(1, '\0');
+
+    for (const Subscriber& subscriber : _topics[topic]) {
+        std::string prefix;
+        prefix.reserve(48 + subscriber.id.length());
+        prefix.append("MESSAGE\nsubscription:").append(subscriber.id)
+              .append("\nmessage-id:").append(std::to_string(_nextMessageId++)).append(1, '\n');
+
+        subscriber.session->deliver(std::move(prefix), shared);
+        ++_messagesDelivered;
+    }
+
+    reply(session, frame);
+}
+
+void StubBroker::subscribe(Session &session, Client &client, const Frame &frame)
+{
+    std::string topic = topicName(frame.getHeader("destination"));
+    const std::string& id = frame.getHeader("id");
+
+    if (topic.empty() || id.empty()) {
+        error(session, "Missing 'destination' or 'id' header in SUBSCRIBE frame");
+        return;
+    }
+
+    auto previous = client.subscriptions.find(id);
+
+    if (previous != client.subscriptions.end())
+        removeSubscription(session, previous->second, id);
+
+    client.subscriptions[id] = topic;
+    _topics[topic].push_back({&session, id});
+    reply(session, frame);
+}
+
+void StubBroker::unsubscribe(Session &session, Client &client, const Frame &frame)
+{
+    const std::string& id = frame.getHeader("id");
+    auto it = client.subscriptions.find(id);
+
+    if (it == client.subscriptions.end()) {
+        error(session, "Missing or unknown 'id' header in UNSUBSCRIBE frame");
+        return;
+    }
+
+    removeSubscription(session, it->second, id);
+    client.subscriptions.erase(it);
+    reply(session, frame);
+}
+
+void StubBroker::disconnect(Session &session, const Frame &frame)
+{
+    reply(session, frame);
+    disconnected(session);
+    session.close();
+}
+
+void StubBroker::reply(Session &session, const Frame &frame)
+{
+    const std::string& receipt = frame.getHeader("receipt");
+
+    if (!receipt.empty())
+        session.deliver(Frame::Receipt(receipt).raw(), nullptr);
+}
+
+void StubBroker::error(Session &session, const std::string &message)
+{
+    session.deliver(Frame::Error(message).raw(), nullptr);
+    disconnected(session);
+    session.close();
+}
+
+void StubBroker::removeSubscription(Session &session, const std::string &topic, const std::string &id)
+{
+    auto it = _topics.find(topic);
+
+    if (it == _topics.end())
+        return;
+
+    std::vector<Subscriber>& subscribers = it->second;
+    subscribers.erase(
+        std::remove_if(subscribers.begin(), subscribers.end(), [&](const Subscriber& s) {
+            return s.session == &session && s.id == id;
+        }),
+        subscribers.end()
+    );
+
+    if (subscribers.empty())
+        _topics.erase(it);
+}
+
+std::string StubBroker::topicName(const std::string &destination)
+{
+    return (!destination.empty() && destination[0] == '/') ? destination.substr(1) : destination;
+}
+
+static void setNoDelay(boost::asio::ip::tcp::socket& socket)
+{
+    boost::system::error_code ec;
+    socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+}
+
+static void setNoDelay(boost::asio::local::stream_protocol::socket&)
+{
+}
+
+// One TCP or Unix domain socket client of the stub broker. Reads are split
+// into frames and handed to the broker; writes are queued and flushed with
+// one gathered write at a time.
+template <typename Socket>
+class SocketSession : public StubBroker::Session
+{
+public:
+    // pending reads, writes and timers hold the session alive through _self
+    static std::shared_ptr<SocketSession> create(Socket socket, StubBroker& broker)
+    {
+        std::shared_ptr<SocketSession> session = std::make_shared<SocketSession>(std::move(socket), broker);
+        session->_self = session;
+        return session;
+    }
+
+    SocketSession(Socket socket, StubBroker& broker)
+        : _socket(std::move(socket))
+        , _broker(broker)
+        , _readBuffer(new char[READ_BUFFER_SIZE])
+        , _pending()
+        , _queued()
+        , _writing()
+        , _closing(false)
+        , _sendTimer(_socket.get_executor())
+        , _receiveTimer(_socket.get_executor())
+        , _lastWrite()
+        , _lastRead()
+        , _self()
+    {
+    }
+
+    SocketSession(const SocketSession&) = delete;
+    SocketSession& operator=(const SocketSession&) = delete;
+
+    void start()
+    {
+        setNoDelay(_socket);
+        read();
+    }
+
+    void deliver(std::string&& prefix, const std::shared_ptr<const std::string>& suffix) override
+    {
+        if (_closing)
+            return;
+
+        _queued.push_back({std::move(prefix), suffix});
+
+        if (_writing.empty())
+            write();
+    }
+
+    void close() override
+    {
+        _closing = true;
+
+        if (_writing.empty())
+            shutdown();
+    }
+
+    void heartBeat(uint32_t sendMs, uint32_t receiveMs) override
+    {
+        _lastWrite = _lastRead = Clock::now();
+
+        if (sendMs != 0)
+            sendHeartBeats(std::chrono::milliseconds(sendMs));
+
+        if (receiveMs != 0)
+            checkLiveness(std::chrono::milliseconds(receiveMs));
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Chunk
+    {
+        std::string prefix;
+        std::shared_ptr<const std::string> suffix;
+    };
+
+    Socket _socket;
+    StubBroker& _broker;
+    std::unique_ptr<char[]> _readBuffer;
+    std::string _pending; // bytes of a frame not fully received yet
+    std::deque<Chunk> _queued;
+    std::vector<Chunk> _writing;
+    bool _closing;
+    boost::asio::steady_timer _sendTimer;
+    boost::asio::steady_timer _receiveTimer;
+    Clock::time_point _lastWrite;
+    Clock::time_point _lastRead;
+    std::weak_ptr<SocketSession> _self;
+
+    void read()
+    {
+        std::shared_ptr<SocketSession> self = _self.lock();
+
+        _socket.async_read_some(
+            boost::asio::buffer(_readBuffer.get(), READ_BUFFER_SIZE),
+            [this, self](const boost::system::error_code& ec, size_t length) {
+                if (ec) {
+                    _sendTimer.cancel();
+                    _receiveTimer.cancel();
+                    _broker.disconnected(*this);
+                    return;
+                }
+
+                _lastRead = Clock::now();
+                onRead(length);
+
+                if (!_closing)
+                    read();
+            }
+        );
+    }
+
+    void onRead(size_t length)
+    {
+        const char* p = _readBuffer.get();
+        const char* end = p + length;
+
+        while (p < end && !_closing) {
+            const char* nul = static_cast<const char*>(std::memchr(p, '\0', end - p));
+
+            if (!nul) {
+                _pending.append(p, end);
+                break;
+            }
+
+            _pending.append(p, nul);
+            p = nul + 1;
+
+            // EOLs between frames are heart-beats
+            size_t start = _pending.find_first_not_of("\r\n");
+
+            if (start != std::string::npos) {
+                _pending.erase(0, start);
+
+                try {
+                    _broker.receive(*this, Frame::parseFrame(std::move(_pending)));
+                } catch (std::exception& e) {
+                    deliver(Frame::Error(e.what()).raw(), nullptr);
+                    _broker.disconnected(*this);
+                    close();
+                }
+            }
+
+            _pending.clear();
+        }
+    }
+
+    void write()
+    {
+        while (!_queued.empty()) {
+            _writing.push_back(std::move(_queued.front()));
+            _queued.pop_front();
+        }
+
+        std::vector<boost::asio::const_buffer> buffers;
+        buffers.reserve(_writing.size() * 2);
+
+        for (const Chunk& chunk : _writing) {
+            buffers.push_back(boost::asio::buffer(chunk.prefix));
+            if (chunk.suffix) buffers.push_back(boost::asio::buffer(*chunk.suffix));
+        }
+
+        std::shared_ptr<SocketSession> self = _self.lock();
+        _lastWrite = Clock::now();
+
+        boost::asio::async_write(_socket, buffers,
+            [this, self](const boost::system::error_code& ec, size_t) {
+                _writing.clear();
+
+                if (ec) {
+                    _queued.clear();
+                    _broker.disconnected(*this);
+                    _closing = true;
+                    shutdown();
+                } else if (!_queued.empty()) {
+                    write();
+                } else if (_closing) {
+                    shutdown();
+                }
+            }
+        );
+    }
+
+    // an EOL whenever nothing else went out for half the interval
+    void sendHeartBeats(std::chrono::milliseconds interval)
+    {
+        std::shared_ptr<SocketSession> self = _self.lock();
+
+        _sendTimer.expires_after(interval / 2);
+        _sendTimer.async_wait([this, self, interval](const boost::system::error_code& ec) {
+            if (ec || _closing)
+                return;
+
+            if (_writing.empty() && Clock::now() - _lastWrite >= interval / 2)
+                deliver(std::string(1, '\n'), nullptr);
+
+            sendHeartBeats(interval);
+        });
+    }
+
+    void checkLiveness(std::chrono::milliseconds interval)
+    {
+        std::shared_ptr<SocketSession> self = _self.lock();
+
+        _receiveTimer.expires_after(interval / 2);
+        _receiveTimer.async_wait([this, self, interval](const boost::system::error_code& ec) {
+            if (ec || _closing)
+                return;
+
+            if (Clock::now() - _lastRead > HEART_BEAT_TOLERANCE * interval) {
+                _broker.disconnected(*this);
+                close();
+                return;
+            }
+
+            checkLiveness(interval);
+        });
+    }
+
+    void shutdown()
+    {
+        boost::system::error_code ec;
+        _sendTimer.cancel();
+        _receiveTimer.cancel();
+        _socket.shutdown(Socket::shutdown_both, ec);
+        _socket.close(ec);
+    }
+};
+
+StubBrokerServer::StubBrokerServer(boost::asio::io_context &ioContext, StubBroker &broker, unsigned short port)
+    : _acceptor(ioContext, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port))
+    , _broker(broker)
+{
+    accept();
+}
+
+unsigned short StubBrokerServer::port() const
+{
+    return _acceptor.local_endpoint().port();
+}
+
+void StubBrokerServer::accept()
+{
+    _acceptor.async_accept([this](const boost::system::error_code& ec, boost::asio::ip::tcp::socket socket) {
+        if (!ec)
+            SocketSession<boost::asio::ip::tcp::socket>::create(std::move(socket), _broker)->start();
+
+        accept();
+    });
+}
+
+StubBrokerUnixServer::StubBrokerUnixServer(boost::asio::io_context &ioContext, StubBroker &broker, const std::string &path)
+    : _acceptor(ioContext)
+    , _broker(broker)
+    , _path(path)
+{
+    ::unlink(path.c_str()); // left by an earlier run
+
+    boost::asio::local::stream_protocol::endpoint endpoint(path);
+    _acceptor.open(endpoint.protocol());
+    _acceptor.bind(endpoint);
+    _acceptor.listen();
+    accept();
+}
+
+StubBrokerUnixServer::~StubBrokerUnixServer()
+{
+    ::unlink(_path.c_str());
+}
+
+void StubBrokerUnixServer::accept()
+{
+    _acceptor.async_accept([this](const boost::system::error_code& ec, boost::asio::local::stream_protocol::socket socket) {
+        if (!ec)
+            SocketSession<boost::asio::local::stream_protocol::socket>::create(std::move(socket), _broker)->start();
+
+        if (ec != boost::asio::error::operation_aborted)
+            accept();
+    });
+}
@@ -0,0 +1,403 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+std::atomic<bool> Trace::_sEnabled(false);
+
+namespace {
+
+const size_t RING_CAPACITY = 16384;
+const std::chrono::milliseconds FLUSH_INTERVAL(50);
+
+struct Record
+{
+    const char* category;
+    const char* name;
+    int64_t ts;
+    int64_t dur;
+    uint64_t id;
+    char phase;
+};
+
+// Written only by the thread that owns it, drained only by the flusher
+struct Ring
+{
+    std::unique_ptr<Record[]> records;
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> dropped;
+    uint32_t tid;
+    const char* threadName;
+    bool inUse;
+
+    Ring() : records(new Record[RING_CAPACITY]), head(0), tail(0), dropped(0), tid(0), threadName(nullptr), inUse(true) {}
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    void push(const Record& record)
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+
+        if (h - tail.load(std::memory_order_acquire) == RING_CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        records[h % RING_CAPACITY] = record;
+        head.store(h + 1, std::memory_order_release);
+    }
+};
+
+struct Drained
+{
+    uint32_t tid;
+    const char* threadName;
+    std::vector<Record> records;
+
+    Drained() : tid(0), threadName(nullptr), records() {}
+    Drained(const Drained&) = default;
+    Drained(Drained&&) = default;
+    Drained& operator=(const Drained&) = default;
+    Drained& operator=(Drained&&) = default;
+};
+
+// A ring is handed to a new thread only once the flusher has emptied it,
+// so every record in a ring belongs to the thread its tid names.
+class Registry
+{
+public:
+    Registry() : _rings(), _mtx(), _nextTid(1) {}
+
+    Ring* acquire(const char* threadName)
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        Ring* ring = nullptr;
+
+        for (auto& r : _rings) {
+            if (!r->inUse && r->head.load() == r->tail.load()) {
+                ring = r.get();
+                break;
+            }
+        }
+
+        if (!ring) {
+            _rings.emplace_back(new Ring());
+            ring = _rings.back().get();
+        }
+
+        ring->inUse = true;
+        ring->tid = _nextTid++;
+        ring->threadName = threadName;
+        return ring;
+    }
+
+    void release(Ring* ring)
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        ring->inUse = false;
+    }
+
+    void setThreadName(Ring* ring, const char* threadName)
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        ring->threadName = threadName;
+    }
+
+    std::vector<Drained> drain()
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        std::vector<Drained> drained;
+
+        for (auto& ring : _rings) {
+            uint64_t t = ring->tail.load(std::memory_order_relaxed);
+            uint64_t h = ring->head.load(std::memory_order_acquire);
+
+            drained.emplace_back();
+            drained.back().tid = ring->tid;
+            drained.back().threadName = ring->threadName;
+
+            for (; t != h; ++t)
+                drained.back().records.push_back(ring->records[t % RING_CAPACITY]);
+
+            ring->tail.store(h, std::memory_order_release);
+        }
+
+        return drained;
+    }
+
+    // forgets what was recorded after the last trace stopped
+    void discard()
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+
+        for (auto& ring : _rings) {
+            ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+            ring->dropped.store(0);
+        }
+    }
+
+    uint64_t dropped()
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        uint64_t total = 0;
+
+        for (auto& ring : _rings)
+            total += ring->dropped.load();
+
+        return total;
+    }
+
+private:
+    std::vector<std::unique_ptr<Ring>> _rings;
+    std::mutex _mtx;
+    uint32_t _nextTid;
+};
+
+Registry& registry()
+{
+    static Registry* instance = new Registry(); // never destroyed: threads may trace during exit
+    return *instance;
+}
+
+struct ThreadRing
+{
+    Ring* ring;
+    const char* name;
+
+    ThreadRing() : ring(nullptr), name(nullptr) {}
+    ~ThreadRing() { if (ring) registry().release(ring); }
+
+    ThreadRing(const ThreadRing&) = delete;
+    ThreadRing& operator=(const ThreadRing&) = delete;
+};
+
+thread_local ThreadRing tLocal;
+
+void push(const Record& record)
+{
+    if (!tLocal.ring)
+        tLocal.ring = registry().acquire(tLocal.name); // rings are only made once a thread traces
+
+    tLocal.ring->push(record);
+}
+
+void writeString(std::ostream& out, const char* s)
+{
+    out << '"';
+
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') out << '\\';
+        out << *s;
+    }
+
+    out << '"';
+}
+
+void writeMicros(std::ostream& out, int64_t ns)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%lld.%03lld",
+                  static_cast<long long>(ns / 1000), static_cast<long long>(ns % 1000));
+    out << buf;
+}
+
+// The trace being written; the flusher thread owns the file until stop()
+class Session
+{
+public:
+    explicit Session(const std::string& path)
+        : _out(path)
+        , _origin(Trace::now())
+        , _events(0)
+        , _named()
+        , _mtx()
+        , _cv()
+        , _stopping(false)
+        , _flusher()
+    {
+        if (!_out)
+            throw std::runtime_error("Could not open '" + path + "' for writing");
+
+        _out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+             << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"StompEMIClient\"}}";
+
+        _flusher = std::thread(&Session::run, this);
+    }
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    uint64_t finish()
+    {
+        {
+            std::lock_guard<std::mutex> lck(_mtx);
+            _stopping = true;
+        }
+
+        _cv.notify_one();
+        _flusher.join();
+
+        _out << "\n]}\n";
+        _out.close();
+
+        return _events;
+    }
+
+private:
+    std::ofstream _out;
+    int64_t _origin;
+    uint64_t _events;
+    std::set<uint32_t> _named;
+
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    bool _stopping;
+    std::thread _flusher;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lck(_mtx);
+
+        while (!_stopping) {
+            _cv.wait_for(lck, FLUSH_INTERVAL);
+
+            lck.unlock();
+            flush();
+            lck.lock();
+        }
+
+        lck.unlock();
+        flush();
+    }
+
+    void flush()
+    {
+        for (const Drained& thread : registry().drain()) {
+            if (thread.threadName && _named.insert(thread.tid).second) {
+                _out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.tid
+                     << ",\"args\":{\"name\":";
+                writeString(_out, thread.threadName);
+                _out << "}}";
+            }
+
+            for (const Record& record : thread.records)
+                write(thread.tid, record);
+        }
+
+        _out.flush();
+    }
+
+    void write(uint32_t tid, const Record& record)
+    {
+        _out << ",\n{\"name\":";
+        writeString(_out, record.name);
+        _out << ",\"cat\":";
+        writeString(_out, record.category);
+        _out << ",\"ph\":\"" << record.phase << "\",\"pid\":1,\"tid\":" << tid << ",\"ts\":";
+        writeMicros(_out, record.ts > _origin ? record.ts - _origin : 0);
+
+        if (record.phase == 'X') {
+            _out << ",\"dur\":";
+            writeMicros(_out, record.dur);
+        } else {
+            _out << ",\"id\":\"0x" << std::hex << record.id << std::dec << '"';
+        }
+
+        _out << '}';
+        ++_events;
+    }
+};
+
+std::unique_ptr<Session> sSession;
+std::mutex sMtxSession;
+
+}
+
+void Trace::start(const std::string &path)
+{
+    std::lock_guard<std::mutex> lck(sMtxSession);
+
+    if (sSession)
+        throw std::logic_error("Already tracing");
+
+    registry().discard();
+    sSession.reset(new Session(path));
+    _sEnabled.store(true);
+}
+
+TraceStats Trace::stop()
+{
+    std::lock_guard<std::mutex> lck(sMtxSession);
+
+    if (!sSession)
+        throw std::logic_error("Not tracing");
+
+    _sEnabled.store(false);
+
+    TraceStats stats;
+    stats.events = sSession->finish();
+    stats.dropped = registry().dropped();
+    sSession.reset();
+
+    return stats;
+}
+
+int64_t Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::setThreadName(const char *name)
+{
+    tLocal.name = name;
+
+    if (tLocal.ring)
+        registry().setThreadName(tLocal.ring, name);
+}
+
+void Trace::complete(const char *category, const char *name, int64_t startNs, int64_t endNs)
+{
+    if (!enabled())
+        return;
+
+    push({category, name, startNs, endNs - startNs, 0, 'X'});
+}
+
+void Trace::asyncBegin(const char *category, const char *name, uint64_t id)
+{
+    if (!enabled())
+        return;
+
+    push({category, name, now(), 0, id, 'b'});
+}
+
+void Trace::asyncEnd(const char *category, const char *name, uint64_t id)
+{
+    if (!enabled())
+        return;
+
+    push({category, name, now(), 0, id, 'e'});
+}
+
+TraceScope::TraceScope(const char *category, const char *name)
+    : _category(category)
+    , _name(name)
+    , _start(Trace::enabled() ? Trace::now() : 0)
+{
+}
+
+TraceScope::~TraceScope()
+{
+    if (_start)
+        Trace::complete(_category, _name, _start, Trace::now());
+}
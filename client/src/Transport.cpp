@@ -0,0 +1,875 @@
+#include "Transport.h"
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#ifdef STOMP_URING
+#include <liburing.h>
+#endif
+
+#include "Frame.h"
+#include "Log.h"
+#include "StubBroker.h"
+
+
+namespace {
+
+// bytes written to a socket that the peer has not taken yet
+size_t unsentBytes(int fd)
+{
+    int queued = 0;
+
+    if (ioctl(fd, SIOCOUTQ, &queued) != 0)
+        return 0;
+
+    return static_cast<size_t>(queued);
+}
+
+boost::asio::ip::tcp::endpoint tcpEndpoint(const std::string& address, const std::string& hostPort)
+{
+    size_t colonPos = hostPort.find(':');
+
+    if (colonPos == std::string::npos)
+        throw std::invalid_argument("Invalid address: '" + address + '\'');
+
+    boost::system::error_code ec;
+    boost::asio::ip::address ip = boost::asio::ip::address::from_string(hostPort.substr(0, colonPos), ec);
+
+    if (ec)
+        throw std::invalid_argument("Invalid address: '" + address + '\'');
+
+    unsigned short port = static_cast<unsigned short>(std::stoi(hostPort.substr(colonPos + 1)));
+    return boost::asio::ip::tcp::endpoint(ip, port);
+}
+
+// TCP and Unix domain sockets: asio does the work
+template <typename Protocol>
+class SocketTransport : public Transport
+{
+public:
+    SocketTransport(boost::asio::io_context& ioContext, std::string address, typename Protocol::endpoint endpoint)
+        : _address(std::move(address))
+        , _socket(ioContext)
+        , _endpoint(std::move(endpoint))
+    {
+    }
+
+    const std::string& address() const override
+    {
+        return _address;
+    }
+
+    void connect(boost::system::error_code& ec) override
+    {
+        _socket.connect(_endpoint, ec);
+    }
+
+    void asyncConnect(ConnectHandler handler) override
+    {
+        _socket.async_connect(_endpoint, std::move(handler));
+    }
+
+    void send(const boost::asio::const_buffer& data, boost::system::error_code& ec) override
+    {
+        _socket.send(boost::asio::buffer(data), 0, ec);
+    }
+
+    void asyncReadUntil(boost::asio::streambuf& buffer, char delimiter, ReadHandler handler) override
+    {
+        boost::asio::async_read_until(_socket, buffer, delimiter, std::move(handler));
+    }
+
+    void shutdown() override
+    {
+        boost::system::error_code ec;
+        _socket.shutdown(Protocol::socket::shutdown_both, ec);
+    }
+
+    void close() override
+    {
+        boost::system::error_code ec;
+        _socket.close(ec);
+    }
+
+    bool isOpen() const override
+    {
+        return _socket.is_open();
+    }
+
+    size_t outboundQueueBytes() const override
+    {
+        SocketTransport* self = const_cast<SocketTransport*>(this); // native_handle() is not const
+        return _socket.is_open() ? unsentBytes(self->_socket.native_handle()) : 0;
+    }
+
+private:
+    std::string _address;
+    typename Protocol::socket _socket;
+    typename Protocol::endpoint _endpoint;
+};
+
+// A transport whose bytes arrive outside asio: they are staged in _inbound
+// under _mtx and handed to the pending read on the loop thread, the way
+// async_read_until would hand them over.
+class StagedTransport : public Transport
+{
+public:
+    // handlers posted to the loop hold the transport alive through _self
+    template <typename T, typename... Args>
+    static std::shared_ptr<T> create(Args&&... args)
+    {
+        std::shared_ptr<T> transport = std::make_shared<T>(std::forward<Args>(args)...);
+        transport->_self = transport;
+        return transport;
+    }
+
+    StagedTransport(boost::asio::io_context& ioContext, std::string address)
+        : _self()
+        , _ioContext(ioContext)
+        , _mtx()
+        , _open(false)
+        , _peerClosed(false)
+        , _readError()
+        , _inbound()
+        , _address(std::move(address))
+        , _readBuffer(nullptr)
+        , _delimiter('\0')
+        , _readHandler()
+        , _readWork()
+        , _notifyPosted(false)
+    {
+    }
+
+    StagedTransport(const StagedTransport&) = delete;
+    StagedTransport& operator=(const StagedTransport&) = delete;
+
+    const std::string& address() const override
+    {
+        return _address;
+    }
+
+    void asyncReadUntil(boost::asio::streambuf& buffer, char delimiter, ReadHandler handler) override
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        _readBuffer = &buffer;
+        _delimiter = delimiter;
+        _readHandler = std::move(handler);
+        _readWork.reset(new ReadWork(_ioContext.get_executor()));
+        notifyLocked();
+    }
+
+    bool isOpen() const override
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        return _open;
+    }
+
+protected:
+    std::weak_ptr<StagedTransport> _self;
+    boost::asio::io_context& _ioContext;
+    mutable std::mutex _mtx;
+    bool _open;
+    bool _peerClosed;
+    boost::system::error_code _readError; // ends the read once _peerClosed, eof if unset
+    std::string _inbound;                 // delivered, not yet read
+
+    ~StagedTransport() override = default;
+
+    // on the loop thread whenever a read is pending, before it is served
+    virtual void readPending() {}
+
+    // one pending completion at a time, however many deliveries arrive
+    void notifyLocked()
+    {
+        if (_notifyPosted || !_readHandler)
+            return;
+
+        _notifyPosted = true;
+        std::shared_ptr<StagedTransport> self = _self.lock();
+        boost::asio::post(_ioContext, [this, self]() { completeRead(); });
+    }
+
+    // ends the pending read with operation_aborted, as closing a socket does
+    void abortRead()
+    {
+        ReadHandler handler;
+        std::unique_ptr<ReadWork> work; // released once the abort is queued
+
+        {
+            std::lock_guard<std::mutex> lck(_mtx);
+            _inbound.clear();
+            handler = std::move(_readHandler);
+            _readHandler = nullptr;
+            work = std::move(_readWork);
+        }
+
+        if (handler) {
+            boost::asio::post(_ioContext, [handler]() {
+                handler(boost::asio::error::operation_aborted, 0);
+            });
+        }
+    }
+
+private:
+    // a socket read keeps run() going, so must a pending staged one
+    using ReadWork = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+
+    std::string _address;
+    boost::asio::streambuf* _readBuffer;
+    char _delimiter;
+    ReadHandler _readHandler;
+    std::unique_ptr<ReadWork> _readWork;
+    bool _notifyPosted;
+
+    // on the loop thread: moves what was delivered into the reader's buffer
+    void completeRead()
+    {
+        readPending();
+
+        ReadHandler handler;
+        boost::system::error_code ec;
+        size_t length = 0;
+
+        {
+            std::lock_guard<std::mutex> lck(_mtx);
+            _notifyPosted = false;
+
+            if (!_readHandler)
+                return;
+
+            if (!_inbound.empty()) {
+                boost::asio::buffer_copy(_readBuffer->prepare(_inbound.size()), boost::asio::buffer(_inbound));
+                _readBuffer->commit(_inbound.size());
+                _inbound.clear();
+            }
+
+            auto data = boost::asio::buffers_begin(_readBuffer->data());
+            auto end = boost::asio::buffers_end(_readBuffer->data());
+            auto found = std::find(data, end, _delimiter);
+
+            if (found != end)
+                length = (found - data) + 1;
+            else if (_peerClosed)
+                ec = _readError ? _readError : boost::asio::error::eof;
+            else
+                return; // wait for more
+
+            handler = std::move(_readHandler);
+            _readHandler = nullptr;
+            _readWork.reset();
+        }
+
+        handler(ec, length);
+    }
+};
+
+// A StubBroker shared by every mem:<name> transport of the process. The
+// broker is not thread safe; it is driven under its lock by whichever
+// client thread sends.
+struct MemoryBroker
+{
+    std::mutex mtx;
+    StubBroker broker;
+
+    MemoryBroker() : mtx(), broker() {}
+
+    static std::shared_ptr<MemoryBroker> get(const std::string& name)
+    {
+        static std::mutex mtxRegistry;
+        static std::unordered_map<std::string, std::weak_ptr<MemoryBroker>> registry;
+
+        std::lock_guard<std::mutex> lck(mtxRegistry);
+        std::shared_ptr<MemoryBroker> broker = registry[name].lock();
+
+        if (!broker) {
+            broker = std::make_shared<MemoryBroker>();
+            registry[name] = broker;
+        }
+
+        return broker;
+    }
+};
+
+// In-process loopback: a send runs the broker's routing on the sending
+// thread, and deliveries land straight in the receiver's inbound buffer.
+class MemoryTransport : public StagedTransport
+{
+public:
+    MemoryTransport(boost::asio::io_context& ioContext, std::string address, std::string name)
+        : StagedTransport(ioContext, std::move(address))
+        , _name(std::move(name))
+        , _peer(*this)
+        , _broker()
+        , _outbound()
+    {
+    }
+
+    ~MemoryTransport() override
+    {
+        close();
+    }
+
+    MemoryTransport(const MemoryTransport&) = delete;
+    MemoryTransport& operator=(const MemoryTransport&) = delete;
+
+    void connect(boost::system::error_code& ec) override
+    {
+        close();
+        ec = boost::system::error_code();
+
+        std::lock_guard<std::mutex> lck(_mtx);
+        _broker = MemoryBroker::get(_name);
+        _open = true;
+        _peerClosed = false;
+        _inbound.clear();
+        _outbound.clear();
+    }
+
+    void asyncConnect(ConnectHandler handler) override
+    {
+        boost::system::error_code ec;
+        connect(ec);
+        boost::asio::post(_ioContext, [handler, ec]() { handler(ec); });
+    }
+
+    void send(const boost::asio::const_buffer& data, boost::system::error_code& ec) override
+    {
+        std::shared_ptr<MemoryBroker> broker;
+
+        {
+            std::lock_guard<std::mutex> lck(_mtx);
+
+            if (!_open || _peerClosed) {
+                ec = boost::asio::error::not_connected;
+                return;
+            }
+
+            broker = _broker;
+        }
+
+        ec = boost::system::error_code();
+        _outbound.append(static_cast<const char*>(data.data()), data.size());
+
+        size_t nul;
+        while ((nul = _outbound.find('\0')) != std::string::npos) {
+            std::string frame = _outbound.substr(0, nul);
+            _outbound.erase(0, nul + 1);
+
+            // EOLs between frames are heart-beats
+            size_t start = frame.find_first_not_of("\r\n");
+            if (start == std::string::npos)
+                continue;
+
+            frame.erase(0, start);
+            std::lock_guard<std::mutex> lck(broker->mtx);
+
+            try {
+                broker->broker.receive(_peer, Frame::parseFrame(std::move(frame)));
+            } catch (std::exception& e) {
+                _peer.deliver(Frame::Error(e.what()).raw(), nullptr);
+                broker->broker.disconnected(_peer);
+                _peer.close();
+            }
+        }
+    }
+
+    void shutdown() override
+    {
+        detach();
+
+        std::lock_guard<std::mutex> lck(_mtx);
+        _peerClosed = true;
+        notifyLocked();
+    }
+
+    void close() override
+    {
+        detach();
+
+        {
+            std::lock_guard<std::mutex> lck(_mtx);
+            _open = false;
+            _broker.reset();
+        }
+
+        abortRead();
+    }
+
+    size_t outboundQueueBytes() const override
+    {
+        return 0; // handed over synchronously
+    }
+
+private:
+    // the broker's view of this client; called under the broker's lock
+    class Peer : public StubBroker::Session
+    {
+    public:
+        explicit Peer(MemoryTransport& transport) : _transport(transport) {}
+
+        Peer(const Peer&) = delete;
+        Peer& operator=(const Peer&) = delete;
+
+        void deliver(std::string&& prefix, const std::shared_ptr<const std::string>& suffix) override
+        {
+            std::lock_guard<std::mutex> lck(_transport._mtx);
+
+            if (_transport._peerClosed)
+                return;
+
+            _transport._inbound.append(prefix);
+            if (suffix) _transport._inbound.append(*suffix);
+            _transport.notifyLocked();
+        }
+
+        void close() override
+        {
+            std::lock_guard<std::mutex> lck(_transport._mtx);
+            _transport._peerClosed = true;
+            _transport.notifyLocked();
+        }
+
+    private:
+        MemoryTransport& _transport;
+    };
+
+    std::string _name;
+    Peer _peer;
+    std::shared_ptr<MemoryBroker> _broker;
+    std::string _outbound; // sent, not a whole frame yet
+
+    // leaves the broker, which forgets the session and its subscriptions
+    void detach()
+    {
+        std::shared_ptr<MemoryBroker> broker;
+
+        {
+            std::lock_guard<std::mutex> lck(_mtx);
+            broker = _broker;
+        }
+
+        if (broker) {
+            std::lock_guard<std::mutex> lck(broker->mtx);
+            broker->broker.disconnected(_peer);
+        }
+    }
+};
+
+#ifdef STOMP_URING
+
+// TCP through io_uring. One multishot recv fills buffers the kernel picks
+// from a provided buffer ring, so inbound frames need no syscall of their
+// own, and sends made while one is in flight go out together in the next.
+// The io_context watches the ring's fd; one wakeup reaps every completion
+// that is ready.
+class UringTransport : public StagedTransport
+{
+public:
+    static const unsigned RING_ENTRIES = 64;
+    static const unsigned RECV_BUFFERS = 64; // a power of two
+    static const unsigned RECV_BUFFER_SIZE = 16384;
+    static const int BUFFER_GROUP = 0;
+
+    UringTransport(boost::asio::io_context& ioContext, std::string address, boost::asio::ip::tcp::endpoint endpoint)
+        : StagedTransport(ioContext, std::move(address))
+        , _endpoint(std::move(endpoint))
+        , _socket(ioContext)
+        , _ring()
+        , _bufferRing(nullptr)
+        , _buffers(RECV_BUFFERS * RECV_BUFFER_SIZE)
+        , _completions(ioContext)
+        , _generation(0)
+        , _recvArmed(false)
+        , _recycled(0)
+        , _watching(false)
+        , _sendInFlight(false)
+        , _sendError()
+        , _pending()
+        , _inFlight()
+    {
+        int ret = io_uring_queue_init(RING_ENTRIES, &_ring, 0);
+        if (ret < 0)
+            throw std::system_error(-ret, std::system_category(), "io_uring_queue_init");
+
+        _bufferRing = io_uring_setup_buf_ring(&_ring, RECV_BUFFERS, BUFFER_GROUP, 0, &ret);
+
+        if (!_bufferRing) {
+            io_uring_queue_exit(&_ring);
+            throw std::system_error(-ret, std::system_category(), "io_uring_setup_buf_ring");
+        }
+
+        for (unsigned bid = 0; bid < RECV_BUFFERS; ++bid)
+            recycle(static_cast<unsigned short>(bid));
+
+        publishRecycled();
+        _completions.assign(_ring.ring_fd);
+    }
+
+    ~UringTransport() override
+    {
+        close();
+        _completions.release(); // the ring closes its own fd
+        io_uring_free_buf_ring(&_ring, _bufferRing, RECV_BUFFERS, BUFFER_GROUP);
+        io_uring_queue_exit(&_ring);
+    }
+
+    UringTransport(const UringTransport&) = delete;
+    UringTransport& operator=(const UringTransport&) = delete;
+
+    void connect(boost::system::error_code& ec) override
+    {
+        close();
+        _socket.connect(_endpoint, ec);
+
+        if (!ec)
+            opened();
+    }
+
+    void asyncConnect(ConnectHandler handler) override
+    {
+        close();
+        std::shared_ptr<StagedTransport> self = _self.lock();
+
+        _socket.async_connect(_endpoint, [this, self, handler](const boost::system::error_code& ec) {
+            if (!ec)
+                opened();
+
+            handler(ec);
+        });
+    }
+
+    void send(const boost::asio::const_buffer& data, boost::system::error_code& ec) override
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+
+        if (!_open) {
+            ec = boost::asio::error::not_connected;
+            return;
+        }
+
+        // an earlier batch failed after its send() had returned
+        if (_sendError) {
+            ec = _sendError;
+            return;
+        }
+
+        ec = boost::system::error_code();
+        _pending.append(static_cast<const char*>(data.data()), data.size());
+
+        if (!_sendInFlight)
+            flushLocked();
+    }
+
+    void shutdown() override
+    {
+        boost::system::error_code ec;
+        _socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec); // the recv ends with 0
+    }
+
+    void close() override
+    {
+        {
+            std::lock_guard<std::mutex> lck(_mtx);
+
+            if (_open) {
+                _open = false;
+                _pending.clear();
+
+                if (_recvArmed) {
+                    io_uring_sqe* sqe = nextSqe();
+                    io_uring_prep_cancel64(sqe, tag(RECV), 0);
+                    io_uring_sqe_set_data64(sqe, tag(WAKE));
+                    _recvArmed = false;
+                }
+
+                // the loop stops watching once nothing is left in flight
+                io_uring_sqe* sqe = nextSqe();
+                io_uring_prep_nop(sqe);
+                io_uring_sqe_set_data64(sqe, tag(WAKE));
+                io_uring_submit(&_ring);
+                ++_generation;
+            }
+        }
+
+        boost::system::error_code ec;
+        _socket.close(ec);
+        abortRead();
+    }
+
+    size_t outboundQueueBytes() const override
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        UringTransport* self = const_cast<UringTransport*>(this); // native_handle() is not const
+        size_t queued = _pending.size() + _inFlight.size();
+
+        return _socket.is_open() ? queued + unsentBytes(self->_socket.native_handle()) : queued;
+    }
+
+private:
+    // user_data is the connection's generation above the operation
+    enum Op : uint64_t { RECV, SEND, WAKE };
+    static const unsigned OP_BITS = 2;
+    static const uint64_t OP_MASK = (1 << OP_BITS) - 1;
+
+    boost::asio::ip::tcp::endpoint _endpoint;
+    boost::asio::ip::tcp::socket _socket;
+    io_uring _ring;                  // submissions under _mtx, completions on the loop thread
+    io_uring_buf_ring* _bufferRing;
+    std::vector<char> _buffers;      // RECV_BUFFERS of RECV_BUFFER_SIZE, lent to the kernel
+    boost::asio::posix::stream_descriptor _completions; // the ring's fd
+    uint64_t _generation;            // completions of an earlier connection are stale
+    bool _recvArmed;
+    int _recycled;                   // buffers given back, not yet published to the kernel
+    bool _watching;                  // loop thread only
+    bool _sendInFlight;
+    boost::system::error_code _sendError;
+    std::string _pending;            // sent while a batch is in flight
+    std::string _inFlight;           // the batch the kernel is sending
+
+    uint64_t tag(Op op) const
+    {
+        return (_generation << OP_BITS) | op;
+    }
+
+    char* bufferAt(unsigned short bid)
+    {
+        return &_buffers[static_cast<size_t>(bid) * RECV_BUFFER_SIZE];
+    }
+
+    void recycle(unsigned short bid)
+    {
+        io_uring_buf_ring_add(_bufferRing, bufferAt(bid), RECV_BUFFER_SIZE, bid,
+                              io_uring_buf_ring_mask(RECV_BUFFERS), _recycled++);
+    }
+
+    void publishRecycled()
+    {
+        if (_recycled > 0) {
+            io_uring_buf_ring_advance(_bufferRing, _recycled);
+            _recycled = 0;
+        }
+    }
+
+    // the submission queue only fills up between submits
+    io_uring_sqe* nextSqe()
+    {
+        io_uring_sqe* sqe = io_uring_get_sqe(&_ring);
+
+        if (!sqe) {
+            io_uring_submit(&_ring);
+            sqe = io_uring_get_sqe(&_ring);
+        }
+
+        if (!sqe)
+            throw std::runtime_error("io_uring submission queue is full");
+
+        return sqe;
+    }
+
+    void opened()
+    {
+        std::lock_guard<std::mutex> lck(_mtx);
+        _open = true;
+        _peerClosed = false;
+        _readError = boost::system::error_code();
+        _sendError = boost::system::error_code();
+        _inbound.clear();
+    }
+
+    // the recv is started from the loop thread, the thread that handles its
+    // completions, so the kernel never interrupts another one for it
+    void readPending() override
+    {
+        bool busy;
+
+        {
+            std::lock_guard<std::mutex> lck(_mtx);
+
+            if (_open && !_recvArmed && !_peerClosed)
+                armRecvLocked();
+
+            busy = _open || _sendInFlight;
+        }
+
+        if (busy)
+            watch();
+    }
+
+    void armRecvLocked()
+    {
+        io_uring_sqe* sqe = nextSqe();
+        io_uring_prep_recv_multishot(sqe, _socket.native_handle(), nullptr, 0, 0);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        io_uring_sqe_set_data64(sqe, tag(RECV));
+        io_uring_submit(&_ring);
+        _recvArmed = true;
+    }
+
+    void flushLocked()
+    {
+        _inFlight.swap(_pending);
+        _pending.clear();
+
+        io_uring_sqe* sqe = nextSqe();
+        io_uring_prep_send(sqe, _socket.native_handle(), _inFlight.data(), _inFlight.size(), MSG_WAITALL | MSG_NOSIGNAL);
+        io_uring_sqe_set_data64(sqe, tag(SEND));
+        io_uring_submit(&_ring);
+        _sendInFlight = true;
+    }
+
+    // loop thread: waits for the ring's fd to signal completions
+    void watch()
+    {
+        if (_watching)
+            return;
+
+        _watching = true;
+        std::weak_ptr<StagedTransport> weak = _self;
+
+        _completions.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+            [this, weak](const boost::system::error_code& ec) {
+                std::shared_ptr<StagedTransport> self = weak.lock();
+                if (!self || ec)
+                    return;
+
+                _watching = false;
+                reap();
+            });
+
+        // completions from before the wait was queued raise no new edge
+        if (io_uring_cq_ready(&_ring) > 0) {
+            std::shared_ptr<StagedTransport> self = _self.lock();
+            boost::asio::post(_ioContext, [this, self]() { reap(); });
+        }
+    }
+
+    void reap()
+    {
+        bool busy;
+
+        {
+            std::lock_guard<std::mutex> lck(_mtx);
+            unsigned head;
+            unsigned seen = 0;
+            io_uring_cqe* cqe;
+
+            io_uring_for_each_cqe(&_ring, head, cqe) {
+                uint64_t data = io_uring_cqe_get_data64(cqe);
+                bool current = (data >> OP_BITS) == _generation;
+
+                switch (data & OP_MASK) {
+                case RECV: received(*cqe, current); break;
+                case SEND: sent(cqe->res, current); break;
+                default: break;
+                }
+
+                ++seen;
+            }
+
+            io_uring_cq_advance(&_ring, seen);
+            publishRecycled();
+            notifyLocked();
+            busy = _open || _sendInFlight;
+        }
+
+        if (busy)
+            watch();
+    }
+
+    void received(const io_uring_cqe& cqe, bool current)
+    {
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            unsigned short bid = static_cast<unsigned short>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+            if (current && cqe.res > 0)
+                _inbound.append(bufferAt(bid), static_cast<size_t>(cqe.res));
+
+            recycle(bid);
+        }
+
+        if (!current || (cqe.flags & IORING_CQE_F_MORE))
+            return;
+
+        // the multishot recv has ended
+        _recvArmed = false;
+
+        if (cqe.res == 0) {
+            _peerClosed = true;
+        } else if (cqe.res < 0 && cqe.res != -ENOBUFS) {
+            _peerClosed = true;
+            _readError = boost::system::error_code(-cqe.res, boost::system::system_category());
+        } else if (_open) {
+            publishRecycled();
+            armRecvLocked(); // out of buffers, or stopped by the kernel; carry on
+        }
+    }
+
+    void sent(int res, bool current)
+    {
+        _sendInFlight = false;
+
+        if (res < 0) {
+            if (current) {
+                _sendError = boost::system::error_code(-res, boost::system::system_category());
+                _pending.clear();
+            }
+        } else if (static_cast<size_t>(res) < _inFlight.size()) {
+            // a short send: the rest goes out ahead of what queued up meanwhile
+            _inFlight.erase(0, static_cast<size_t>(res));
+            _inFlight.append(_pending);
+            _pending.swap(_inFlight);
+        }
+
+        _inFlight.clear();
+
+        if (!_pending.empty() && _open && !_sendError)
+            flushLocked();
+    }
+};
+
+#endif
+
+}
+
+std::shared_ptr<Transport> Transport::create(boost::asio::io_context& ioContext, const std::string& address)
+{
+    using boost::asio::ip::tcp;
+
+    if (address.compare(0, 5, "unix:") == 0) {
+        using boost::asio::local::stream_protocol;
+        return std::make_shared<SocketTransport<stream_protocol>>(
+            ioContext, address, stream_protocol::endpoint(address.substr(5)));
+    }
+
+    if (address.compare(0, 4, "mem:") == 0)
+        return StagedTransport::create<MemoryTransport>(ioContext, address, address.substr(4));
+
+    if (address.compare(0, 6, "uring:") == 0) {
+        tcp::endpoint endpoint = tcpEndpoint(address, address.substr(6));
+
+#ifdef STOMP_URING
+        std::string reason;
+
+        try {
+            return StagedTransport::create<UringTransport>(ioContext, address, endpoint);
+        } catch (std::system_error& e) {
+            reason = std::string("io_uring is unavailable (") + e.what() + ')';
+        }
+#else
+        std::string reason = "Built without io_uring";
+#endif
+
+        static std::once_flag warned;
+        std::call_once(warned, [&reason]() { Log::warn(reason + ", using a plain socket"); });
+
+        return std::make_shared<SocketTransport<tcp>>(ioContext, address, endpoint);
+    }
+
+    return std::make_shared<SocketTransport<tcp>>(ioContext, address, tcpEndpoint(address, address));
+}
@@ -6,6 +6,9 @@
 #include <vector>
 #include <sstream>
 #include <iostream>
+#include <cstring>
+#include <stdexcept>
+#include <limits>
 
 #include "json.hpp"
 
@@ -19,19 +22,19 @@ Event::Event(std::string channel_name,
              std::string description,
              std::map<std::string,
              std::string> general_information)
-    : _channelName(channel_name)
-    , _city(city)
-    , _name(name)
+    : _channelName(std::move(channel_name))
+    , _city(std::move(city))
+    , _name(std::move(name))
     , _datetime(date_time)
-    , _description(description)
-    , _generalInfo(general_information)
+    , _description(std::move(description))
+    , _generalInfo(std::move(general_information))
     , _eventOwner()
 {
 }
 
 void Event::setEventOwnerUser(std::string setEventOwnerUser)
 {
-    _eventOwner = setEventOwnerUser;
+    _eventOwner = std::move(setEventOwnerUser);
 }
 
 void Event::setChannelName(const std::string &channelName)
@@ -92,61 +95,6 @@ std::string Event::toString() const
     return stream.str();
 }
 
-std::unordered_map<std::string, std::string> Event::parseFrameBody(const std::string &frameBody)
-{
-    std::istringstream stream(frameBody);
-    std::string line;
-    std::unordered_map<std::string, std::string> data;
-
-
-    while (std::getline(stream, line)) {
-        size_t colonPos = line.find(':');
-
-        if (colonPos != std::string::npos) {
-            std::string key = line.substr(0, colonPos);
-
-            if (key == "general information") {
-                std::string generalInfo;
-                
-                while (isspace(stream.peek())) {
-                    std::getline(stream, line);
-                    generalInfo.append(line.substr(1) + '\n');
-                }
-
-                data[key] = generalInfo;
-                continue;
-            }
-
-            if (key == "description") {
-                std::string description = line.substr(colonPos + 1);
-                while (std::getline(stream, line)) description.append(line + '\n');
-                data[key] = description;
-                break;
-            }
-
-            data[key] = line.substr(colonPos + 1);
-        }
-    }
-
-    return data;
-}
-
-std::map<std::string, std::string> Event::parseGeneralInfo(const std::string &info)
-{
-    std::istringstream stream(info);
-    std::string line;
-    std::map<std::string, std::string> data;
-
-    while (std::getline(stream, line)) {
-        size_t colonPos = line.find(':');
-
-        if (colonPos != std::string::npos)
-            data[line.substr(0, colonPos)] = line.substr(colonPos + 1);
-    }
-
-    return data;
-}
-
 std::vector<Event> Event::fromJsonFile(const std::string &path)
 {
     std::vector<Event> events;
@@ -174,7 +122,7 @@ std::vector<Event> Event::fromJsonFile(const std::string &path)
             event["event_name"],
             event["date_time"],
             event["description"],
-            general_information
+            std::move(general_information)
         );
     }
     
@@ -187,23 +135,106 @@ const std::string &Event::get_description() const
 }
 
 Event::Event(const std::string &frame_body)
-    : _channelName()
-    , _city()
-    , _name()
-    , _datetime(0)
-    , _description()
+    : Event(EventFields::parse(frame_body))
+{
+}
+
+Event::Event(const EventFields &fields)
+    : _channelName(fields.channel.str())
+    , _city(fields.city.str())
+    , _name(fields.name.str())
+    , _datetime(fields.datetime())
+    , _description(fields.description.str())
     , _generalInfo()
-    , _eventOwner()                        
-                                            
-{
-    std::unordered_map<std::string, std::string> data = parseFrameBody(frame_body);
-    std::unordered_map<std::string, std::string>::iterator it;
-
-    if ((it = data.find("user")) != data.end()) _eventOwner = it->second;
-    if ((it = data.find("channel name")) != data.end()) _channelName = it->second;
-    if ((it = data.find("city")) != data.end()) _city = it->second;
-    if ((it = data.find("event name")) != data.end()) _name = it->second;
-    if ((it = data.find("date time")) != data.end()) _datetime = std::stoi(it->second);
-    if ((it = data.find("general information")) != data.end()) _generalInfo = parseGeneralInfo(it->second);
-    if ((it = data.find("description")) != data.end()) _description = it->second;
+    , _eventOwner(fields.user.str())
+{
+    fields.forEachInfo([this](StringRef key, StringRef value) {
+        _generalInfo[key.str()] = value.str();
+    });
+}
+
+std::string StringRef::str() const
+{
+    return (length == 0) ? std::string() : std::string(data, length);
+}
+
+EventFields EventFields::parse(const std::string &frameBody)
+{
+    EventFields fields = {};
+    const char* p = frameBody.data();
+    const char* end = p + frameBody.length();
+
+    while (p < end) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+
+        const char* colon = static_cast<const char*>(std::memchr(p, ':', eol - p));
+
+        if (!colon) {
+            p = eol + 1;
+            continue;
+        }
+
+        std::string::size_type keyLength = colon - p;
+        StringRef value = {colon + 1, static_cast<size_t>(eol - colon - 1)};
+
+        if (keyLength == 19 && std::memcmp(p, "general information", 19) == 0) {
+            // the block of indented lines that follows
+            const char* block = eol + 1;
+            const char* blockEnd = block;
+
+            while (blockEnd < end && (*blockEnd == '\t' || *blockEnd == ' ')) {
+                const char* next = static_cast<const char*>(std::memchr(blockEnd, '\n', end - blockEnd));
+                blockEnd = next ? next + 1 : end;
+            }
+
+            fields.generalInfo = {block, static_cast<size_t>(blockEnd - block)};
+            p = blockEnd;
+            continue;
+        }
+
+        if (keyLength == 11 && std::memcmp(p, "description", 11) == 0) {
+            // the description runs to the end of the body
+            const char* descEnd = end;
+            while (descEnd > colon + 1 && descEnd[-1] == '\n') --descEnd;
+            fields.description = {colon + 1, static_cast<size_t>(descEnd - colon - 1)};
+            break;
+        }
+
+        if (keyLength == 4 && std::memcmp(p, "user", 4) == 0) fields.user = value;
+        else if (keyLength == 12 && std::memcmp(p, "channel name", 12) == 0) fields.channel = value;
+        else if (keyLength == 4 && std::memcmp(p, "city", 4) == 0) fields.city = value;
+        else if (keyLength == 10 && std::memcmp(p, "event name", 10) == 0) fields.name = value;
+        else if (keyLength == 9 && std::memcmp(p, "date time", 9) == 0) fields.dateTime = value;
+
+        p = eol + 1;
+    }
+
+    return fields;
+}
+
+int EventFields::datetime() const
+{
+    if (!dateTime.data)
+        return 0;
+
+    const char* p = dateTime.data;
+    const char* end = p + dateTime.length;
+    bool negative = (p < end && *p == '-');
+    if (negative) ++p;
+
+    if (p == end || *p < '0' || *p > '9')
+        throw std::invalid_argument("Invalid date time: '" + dateTime.str() + '\'');
+
+    // checked before each digit, so an oversized date time is refused rather than overflowing
+    long limit = static_cast<long>(std::numeric_limits<int>::max()) + (negative ? 1 : 0);
+    long value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        if (value > (limit - (*p - '0')) / 10)
+            throw std::invalid_argument("Date time out of range: '" + dateTime.str() + '\'');
+
+        value = value * 10 + (*p - '0');
+    }
+
+    return static_cast<int>(negative ? -value : value);
 }
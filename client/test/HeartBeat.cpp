@@ -0,0 +1,164 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+
+#include "Frame.h"
+#include "Log.h"
+#include "StompProtocol.h"
+#include "TestBroker.h"
+
+// Checks heart-beat header parsing, the interval each side agrees on, and
+// that a login goes through with heart-beating off when the broker's
+// CONNECTED carries a malformed heart-beat
+
+static bool sOk = true;
+
+static void fail(const std::string& message)
+{
+    std::cout << "FAIL: " << message << '\n';
+    sOk = false;
+}
+
+static void expectParsed(const std::string& header, uint32_t send, uint32_t receive)
+{
+    try {
+        HeartBeat heartBeat = HeartBeat::parse(header);
+
+        if (heartBeat.send != send || heartBeat.receive != receive)
+            fail("'" + header + "' parsed as " + heartBeat.toString());
+    } catch (std::exception& e) {
+        fail("'" + header + "' refused: " + e.what());
+    }
+}
+
+static void expectRefused(const std::string& header)
+{
+    try {
+        HeartBeat heartBeat = HeartBeat::parse(header);
+        fail("'" + header + "' accepted as " + heartBeat.toString());
+    } catch (std::invalid_argument&) {
+    } catch (std::exception& e) {
+        fail("'" + header + "' refused with the wrong exception: " + e.what());
+    }
+}
+
+static void parsing()
+{
+    expectParsed("", 0, 0); // no header
+    expectParsed("0,0", 0, 0);
+    expectParsed("1000,2000", 1000, 2000);
+    expectParsed("4294967295,0", 4294967295u, 0);
+    expectParsed("0010,0", 10, 0);
+
+    expectRefused("abc");
+    expectRefused("1000");
+    expectRefused("1000,");
+    expectRefused(",1000");
+    expectRefused("1,2,3");
+    expectRefused("-1,0");
+    expectRefused("+1,0");
+    expectRefused(" 1,0");
+    expectRefused("1.5,0");
+    expectRefused("4294967296,0");
+    expectRefused("99999999999,0");
+    expectRefused("123456789012345678901234567890,0");
+
+    HeartBeat heartBeat = {1000, 2000};
+    if (heartBeat.toString() != "1000,2000")
+        fail("1000,2000 written as " + heartBeat.toString());
+}
+
+static void intervals()
+{
+    if (HeartBeat::interval(0, 5000) != 0 || HeartBeat::interval(5000, 0) != 0)
+        fail("heart-beating not off when either side opts out");
+
+    if (HeartBeat::interval(100, 200) != 200 || HeartBeat::interval(300, 200) != 300)
+        fail("the agreed interval is not the larger of the two");
+}
+
+// the intervals a client logging in to the stub broker ends up with
+static void negotiation()
+{
+    Broker broker(0, {500, 3000});
+
+    {
+        StompProtocol protocol;
+        protocol.setHeartBeat({1000, 2000});
+        protocol.login("127.0.0.1:" + std::to_string(broker.server.port()), "alice", "secret");
+
+        // the client sends at most every max(1000, 3000), the broker every max(500, 2000)
+        bool agreed = waitFor([&protocol]() {
+            HeartBeat heartBeat = protocol.negotiatedHeartBeat();
+            return protocol.isLoggedIn() && heartBeat.send == 3000 && heartBeat.receive == 2000;
+        }, 5);
+
+        if (!agreed)
+            fail("negotiated " + protocol.negotiatedHeartBeat().toString() + ", expected 3000,2000");
+
+        protocol.logout();
+        waitFor([&protocol]() { return !protocol.isLoggedIn(); }, 2);
+    }
+}
+
+// A broker that answers the CONNECT with a heart-beat the client cannot parse
+static void malformed()
+{
+    boost::asio::io_context ioContext;
+    boost::asio::ip::tcp::acceptor acceptor(ioContext, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+
+    std::thread broker([&acceptor]() {
+        boost::system::error_code ec;
+        boost::asio::ip::tcp::socket socket = acceptor.accept(ec);
+        boost::asio::streambuf connect;
+
+        if (ec || boost::asio::read_until(socket, connect, '\0', ec) == 0)
+            return;
+
+        std::string connected = "CONNECTED\nversion:1.2\nheart-beat:abc\n\n";
+        connected.push_back('\0');
+        boost::asio::write(socket, boost::asio::buffer(connected), ec);
+
+        // hold the connection open until the client closes it
+        char byte;
+        while (!ec)
+            socket.read_some(boost::asio::buffer(&byte, 1), ec);
+    });
+
+    {
+        StompProtocol protocol;
+        protocol.setHeartBeat({1000, 1000});
+        protocol.login("127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()), "alice", "secret");
+
+        if (!waitFor([&protocol]() { return protocol.isLoggedIn(); }, 5))
+            fail("not logged in after a malformed heart-beat in CONNECTED");
+
+        // the intervals are stored just after the login state, so give them a moment
+        bool heartBeating = waitFor([&protocol]() {
+            HeartBeat heartBeat = protocol.negotiatedHeartBeat();
+            return heartBeat.send != 0 || heartBeat.receive != 0;
+        }, 0.1);
+
+        if (heartBeating)
+            fail("heart-beating " + protocol.negotiatedHeartBeat().toString() + " after a malformed heart-beat, expected 0,0");
+
+        protocol.closeConnection();
+    }
+
+    broker.join();
+}
+
+int main()
+{
+    Log::setLevel(LogLevel::ERROR); // the malformed header is a warning
+
+    parsing();
+    intervals();
+    negotiation();
+    malformed();
+
+    std::cout << (sOk ? "PASS\n" : "FAIL\n");
+    return sOk ? 0 : 1;
+}
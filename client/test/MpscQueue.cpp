@@ -0,0 +1,143 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MpscQueue.h"
+
+// Pushes from several producer threads while one consumer drains the queue,
+// and checks that nothing is lost, duplicated or reordered per producer
+
+static const size_t PRODUCERS = 4;
+static const size_t PER_PRODUCER = 200000;
+
+// a producer's index in the top bits, its sequence number below
+static uint64_t item(uint64_t producer, uint64_t n)
+{
+    return (producer << 32) | n;
+}
+
+static bool singleThreaded()
+{
+    bool ok = true;
+    MpscQueue<std::string> queue(5);
+
+    // capacity rounds up to a power of two
+    if (queue.stats().capacity != 8) {
+        std::cout << "FAIL: capacity " << queue.stats().capacity << ", expected 8\n";
+        ok = false;
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        if (!queue.tryPush(std::to_string(i))) {
+            std::cout << "FAIL: push " << i << " refused below capacity\n";
+            ok = false;
+        }
+    }
+
+    std::string extra = "extra";
+    if (queue.tryPush(std::move(extra))) {
+        std::cout << "FAIL: push accepted into a full queue\n";
+        ok = false;
+    }
+
+    if (queue.size() != 8 || queue.stats().highWaterMark != 8) {
+        std::cout << "FAIL: size " << queue.size() << ", high water " << queue.stats().highWaterMark << '\n';
+        ok = false;
+    }
+
+    std::string popped;
+
+    for (int i = 0; i < 8; ++i) {
+        if (!queue.tryPop(popped) || popped != std::to_string(i)) {
+            std::cout << "FAIL: pop " << i << " returned '" << popped << "'\n";
+            ok = false;
+        }
+    }
+
+    if (queue.tryPop(popped) || !queue.empty()) {
+        std::cout << "FAIL: pop succeeded on an empty queue\n";
+        ok = false;
+    }
+
+    // slots are reused once the consumer has freed them
+    std::string again = "again";
+    if (!queue.tryPush(std::move(again)) || !queue.tryPop(popped) || popped != "again") {
+        std::cout << "FAIL: queue unusable after wrapping\n";
+        ok = false;
+    }
+
+    return ok;
+}
+
+static bool contended()
+{
+    MpscQueue<uint64_t> queue(64); // small, so producers keep finding it full
+    std::vector<std::thread> producers;
+
+    for (size_t p = 0; p < PRODUCERS; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (size_t n = 0; n < PER_PRODUCER; ++n) {
+                while (!queue.tryPush(item(p, n)))
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<uint64_t> next(PRODUCERS, 0);
+    size_t received = 0;
+    bool ok = true;
+
+    // keeps draining after a failure so that no producer is left blocked
+    while (received < PRODUCERS * PER_PRODUCER) {
+        uint64_t value;
+
+        if (!queue.tryPop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        uint64_t producer = value >> 32;
+        uint64_t n = value & 0xffffffff;
+
+        if (producer >= PRODUCERS) {
+            std::cout << "FAIL: got an item that no producer pushed\n";
+            ok = false;
+            ++received;
+            continue;
+        }
+
+        if (ok && n != next[producer]) {
+            std::cout << "FAIL: got item " << n << " of producer " << producer
+                      << ", expected " << next[producer] << '\n';
+            ok = false;
+        }
+
+        next[producer] = n + 1;
+        ++received;
+    }
+
+    for (std::thread& t : producers)
+        t.join();
+
+    uint64_t value;
+    if (queue.tryPop(value)) {
+        std::cout << "FAIL: items left over after every producer's last one\n";
+        ok = false;
+    }
+
+    std::cout << "producers:     " << PRODUCERS << '\n'
+              << "items:         " << received << '\n';
+
+    return ok;
+}
+
+int main()
+{
+    bool ok = singleThreaded();
+    ok = contended() && ok;
+
+    std::cout << (ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+#include "StompProtocol.h"
+
+// Counts every heap allocation made while the receive path runs
+
+static size_t sAllocations = 0;
+static size_t sBytes = 0;
+
+void* operator new(size_t size)
+{
+    ++sAllocations;
+    sBytes += size;
+
+    void* p = std::malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+
+static const size_t DESCRIPTION_LENGTH = 2048;
+
+std::string messageBody()
+{
+    return "user:bob\n"
+           "city:Vice City\n"
+           "event name:Hit and Run\n"
+           "date time:1735006800\n"
+           "general information:\n"
+           "\tactive:true\n"
+           "\tforces_arrival_at_scene:true\n"
+           "description:" + std::string(DESCRIPTION_LENGTH, 'x');
+}
+
+std::string messageFrame(int id)
+{
+    return "MESSAGE\n"
+           "subscription:1\n"
+           "message-id:" + std::to_string(id) + "\n"
+           "destination:/police\n"
+           "\n" + messageBody();
+}
+
+int main()
+{
+    const int count = 10000;
+    StompProtocol protocol;
+
+    std::vector<std::string> frames;
+    frames.reserve(count);
+    for (int i = 0; i < count; ++i) frames.push_back(messageFrame(i));
+
+    // the first message creates the channel and the owner's index
+    protocol.dispatch(Frame::parseFrame(messageFrame(-1)));
+
+    sAllocations = 0;
+    sBytes = 0;
+
+    for (std::string& frame : frames)
+        protocol.dispatch(Frame::parseFrame(std::move(frame)));
+
+    double allocationsPerMessage = static_cast<double>(sAllocations) / count;
+    double bytesPerMessage = static_cast<double>(sBytes) / count;
+    size_t bodyLength = messageBody().length();
+
+    std::cout << "messages:      " << count << '\n'
+              << "body size:     " << bodyLength << " B\n"
+              << "allocations/op " << allocationsPerMessage << '\n'
+              << "bytes/op       " << bytesPerMessage << '\n';
+
+    bool ok = true;
+
+    // one header map (bucket array + 3 nodes) per frame; the body is moved out
+    // of the read buffer and copied once, into the channel's slab
+    if (allocationsPerMessage > 5) {
+        std::cout << "FAIL: too many allocations per message\n";
+        ok = false;
+    }
+
+    // any redundant deep copy of the body would put this above 2x
+    if (bytesPerMessage > 1.5 * bodyLength) {
+        std::cout << "FAIL: message body copied more than once\n";
+        ok = false;
+    }
+
+    std::vector<Event> stored = protocol.getReportsFrom("police", "bob");
+
+    if (stored.size() != static_cast<size_t>(count + 1)
+        || stored.back().get_description().length() != DESCRIPTION_LENGTH
+        || stored.back().get_general_information().at("active") != "true") {
+        std::cout << "FAIL: stored events do not match the received ones\n";
+        ok = false;
+    }
+
+    // an oversized date time is refused like any other malformed message, not wrapped around
+    std::string oversized = messageFrame(count);
+    oversized.replace(oversized.find("1735006800"), 10, "99999999999");
+
+    try {
+        protocol.dispatch(Frame::parseFrame(std::move(oversized)));
+        std::cout << "FAIL: a date time past the range of int was accepted\n";
+        ok = false;
+    } catch (std::invalid_argument&) {
+    }
+
+    if (protocol.getReportsFrom("police", "bob").size() != stored.size()) {
+        std::cout << "FAIL: a message with an oversized date time was stored\n";
+        ok = false;
+    }
+
+    std::cout << (ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
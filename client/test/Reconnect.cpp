@@ -0,0 +1,119 @@
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "Log.h"
+#include "StompProtocol.h"
+#include "TestBroker.h"
+
+// Restarts the broker under a client that has auto-reconnect on, and checks
+// that the client logs back in, rejoins its channel on the broker's side
+// too, and keeps what it had stored before the outage
+
+static Event policeEvent(const std::string& name)
+{
+    return Event("police", "Vice City", name, static_cast<int>(std::time(nullptr)), "reconnect test",
+                 std::map<std::string, std::string>{{"active", "true"}, {"forces_arrival_at_scene", "false"}});
+}
+
+static bool loginAndJoin(StompProtocol& protocol, const std::string& address, const std::string& user)
+{
+    protocol.login(address, user, "secret");
+
+    if (!waitFor([&protocol]() { return protocol.isLoggedIn(); }, 5))
+        return false;
+
+    protocol.subscribe("police");
+    return waitFor([&protocol]() { return protocol.isSubscribed("police"); }, 5);
+}
+
+static void logout(StompProtocol& protocol)
+{
+    try {
+        protocol.logout();
+    } catch (std::exception&) {
+    }
+
+    waitFor([&protocol]() { return !protocol.isLoggedIn(); }, 2);
+}
+
+int main()
+{
+    Log::setLevel(LogLevel::OFF); // the dropped connection is an error to the client
+
+    std::unique_ptr<Broker> broker(new Broker(0));
+    unsigned short port = broker->server.port();
+    std::string address = "127.0.0.1:" + std::to_string(port);
+
+    bool ok = true;
+    StompProtocol alice;
+    alice.setAutoReconnect(true);
+
+    if (!loginAndJoin(alice, address, "alice")) {
+        std::cout << "FAIL: could not log in and join\nFAIL\n";
+        return 1;
+    }
+
+    Event before = policeEvent("Before the outage");
+    alice.report(before);
+
+    if (!waitFor([&alice]() { return alice.getReportsFrom("police", "alice").size() == 1; }, 5)) {
+        std::cout << "FAIL: own report not received before the outage\n";
+        ok = false;
+    }
+
+    broker.reset();
+
+    if (!waitFor([&alice]() { return alice.isReconnecting(); }, 5)) {
+        std::cout << "FAIL: the lost connection was not noticed\n";
+        ok = false;
+    }
+
+    broker.reset(new Broker(port));
+
+    bool back = waitFor([&alice]() {
+        return !alice.isReconnecting() && alice.isLoggedIn() && alice.isSubscribed("police");
+    }, 10);
+
+    if (!back) {
+        std::cout << "FAIL: not logged back in and subscribed after the broker came back\n";
+        ok = false;
+    }
+
+    if (alice.getMetrics().reconnects.load() != 1) {
+        std::cout << "FAIL: " << alice.getMetrics().reconnects.load() << " reconnects counted, expected 1\n";
+        ok = false;
+    }
+
+    // only a subscription the new broker knows about gets bob's report to alice
+    if (back) {
+        StompProtocol bob;
+
+        if (loginAndJoin(bob, address, "bob")) {
+            Event after = policeEvent("After the outage");
+            bob.report(after);
+
+            if (!waitFor([&alice]() { return alice.getReportsFrom("police", "bob").size() == 1; }, 5)) {
+                std::cout << "FAIL: the channel was not rejoined on the broker\n";
+                ok = false;
+            }
+        } else {
+            std::cout << "FAIL: a second client could not log in and join\n";
+            ok = false;
+        }
+
+        logout(bob);
+    }
+
+    if (alice.getReportsFrom("police", "alice").size() != 1) {
+        std::cout << "FAIL: events stored before the outage were lost\n";
+        ok = false;
+    }
+
+    logout(alice);
+
+    std::cout << (ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "Log.h"
+#include "ScriptRunner.h"
+#include "StompProtocol.h"
+
+// Runs a script whose every line depends on the one before it against the
+// in-process broker. Issued back to back, the join would go out before the
+// login was answered and the summary would find none of the reports, so the
+// summary only comes out whole if each command was held back just long enough.
+
+static const char* SUMMARY_FILE = "bin/ScriptRunnerTest.summary";
+static const size_t EVENTS = 7; // in test/events1.json
+
+static std::string readFile(const std::string& path)
+{
+    std::ifstream in(path);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+int main()
+{
+    std::remove(SUMMARY_FILE);
+
+    std::istringstream script(
+        "login mem:script alice secret\n"
+        "join police\n"
+        "report test/events1.json\n"
+        "# comments and blank lines are not steps\n"
+        "\n"
+        "summary police alice " + std::string(SUMMARY_FILE) + "\n"
+        "logout\n");
+
+    std::ostringstream timings;
+
+    {
+        StompProtocol protocol(StompProtocol::defaultDecodeWorkers(), false);
+        ScriptRunner runner(protocol);
+
+        runner.load(script);
+        runner.run();
+        Log::flush();
+        runner.printTimings(timings);
+    }
+
+    std::cout << timings.str();
+
+    bool ok = true;
+    std::string summary = readFile(SUMMARY_FILE);
+
+    if (summary.find("Total: " + std::to_string(EVENTS) + '\n') == std::string::npos) {
+        std::cout << "FAIL: the summary does not hold all " << EVENTS << " reported events\n";
+        ok = false;
+    }
+
+    // one row per step, each with a completion time; '-' marks a step that never completed
+    std::istringstream rows(timings.str());
+    std::string row;
+    size_t steps = 0;
+
+    std::getline(rows, row); // header
+
+    while (std::getline(rows, row) && row.compare(0, 6, "Total ") != 0) {
+        ++steps;
+
+        if (row.find(" -  ") != std::string::npos) {
+            std::cout << "FAIL: step never completed: " << row << '\n';
+            ok = false;
+        }
+    }
+
+    if (steps != 5) {
+        std::cout << "FAIL: " << steps << " steps timed, expected 5\n";
+        ok = false;
+    }
+
+    std::remove(SUMMARY_FILE);
+
+    std::cout << (ok ? "PASS\n" : "FAIL\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+#include <boost/asio.hpp>
+
+#include "StubBroker.h"
+
+
+// What the tests that log in to a stub broker share
+
+using Clock = std::chrono::steady_clock;
+
+// Polls predicate until it holds or seconds have passed
+template <typename Predicate>
+static bool waitFor(Predicate predicate, double seconds)
+{
+    Clock::time_point deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+
+    while (!predicate()) {
+        if (Clock::now() > deadline)
+            return false;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+}
+
+// A stub broker on its own thread, on the given port or any free one for 0.
+// Destroying it drops every connection without a word to the clients, as a
+// crashed broker would.
+struct Broker
+{
+    StubBroker broker;
+    boost::asio::io_context ioContext;
+    StubBrokerServer server;
+    std::thread thread;
+
+    explicit Broker(unsigned short port, HeartBeat heartBeat = {0, 0})
+        : broker()
+        , ioContext()
+        , server(ioContext, broker, port)
+        , thread()
+    {
+        broker.setHeartBeat(heartBeat); // before the thread, which reads it
+        thread = std::thread([this]() { ioContext.run(); });
+    }
+
+    ~Broker()
+    {
+        ioContext.stop();
+        thread.join();
+    }
+};
@@ -0,0 +1,235 @@
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+
+#include "Frame.h"
+#include "Log.h"
+#include "StubBroker.h"
+#include "Transport.h"
+
+// Talks STOMP to the stub broker through every kind of transport, frame by
+// frame, and checks what the Transport interface promises: handlers never
+// run inside the call that starts them, close() aborts a pending read and
+// shutdown() ends it like a hang-up
+
+static const char* SOCKET_PATH = "bin/TransportTest.sock";
+
+static bool sOk = true;
+
+static void fail(const std::string& address, const std::string& message)
+{
+    std::cout << "FAIL: " << address << ": " << message << '\n';
+    sOk = false;
+}
+
+struct Read
+{
+    bool done;
+    boost::system::error_code ec;
+    std::string frame;
+};
+
+// Reads one frame, running the client's loop until it is in or a second has passed
+static Read readFrame(boost::asio::io_context& ioContext, Transport& transport, boost::asio::streambuf& buffer)
+{
+    Read read = {false, boost::system::error_code(), std::string()};
+
+    transport.asyncReadUntil(buffer, '\0', [&read, &buffer](const boost::system::error_code& ec, size_t length) {
+        read.done = true;
+        read.ec = ec;
+
+        if (!ec) {
+            read.frame.assign(boost::asio::buffers_begin(buffer.data()), boost::asio::buffers_begin(buffer.data()) + length - 1);
+            buffer.consume(length);
+        }
+    });
+
+    if (read.done)
+        fail(transport.address(), "read completed inside asyncReadUntil");
+
+    ioContext.restart();
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+    while (!read.done && std::chrono::steady_clock::now() < deadline)
+        ioContext.run_one_for(std::chrono::milliseconds(10));
+
+    return read;
+}
+
+static bool sendFrame(Transport& transport, const Frame& frame)
+{
+    std::string raw = frame.raw();
+    boost::system::error_code ec;
+    transport.send(boost::asio::buffer(raw), ec);
+
+    if (ec)
+        fail(transport.address(), "send: " + ec.message());
+
+    return !ec;
+}
+
+// CONNECT, SUBSCRIBE and a SEND that comes back to the sender
+static void exchange(const std::string& address)
+{
+    boost::asio::io_context ioContext;
+    std::shared_ptr<Transport> transport = Transport::create(ioContext, address);
+    boost::asio::streambuf buffer;
+
+    if (transport->address() != address)
+        fail(address, "address() is '" + transport->address() + '\'');
+
+    bool connected = false;
+    boost::system::error_code connectError;
+    transport->asyncConnect([&connected, &connectError](const boost::system::error_code& ec) {
+        connected = true;
+        connectError = ec;
+    });
+
+    if (connected)
+        fail(address, "connect completed inside asyncConnect");
+
+    while (!connected && ioContext.run_one_for(std::chrono::seconds(1)) > 0) {
+    }
+
+    if (!connected || connectError || !transport->isOpen()) {
+        fail(address, "could not connect: " + connectError.message());
+        return;
+    }
+
+    if (!sendFrame(*transport, Frame::Connect("alice", "secret")))
+        return;
+
+    Read read = readFrame(ioContext, *transport, buffer);
+    if (read.ec || read.frame.compare(0, 10, "CONNECTED\n") != 0) {
+        fail(address, "no CONNECTED: " + (read.ec ? read.ec.message() : read.frame));
+        return;
+    }
+
+    Event event("police", "Vice City", "Transport test", static_cast<int>(std::time(nullptr)), "over " + address,
+                std::map<std::string, std::string>{{"active", "true"}, {"forces_arrival_at_scene", "false"}});
+
+    if (!sendFrame(*transport, Frame::Subscribe("police", 1, 1)) || !sendFrame(*transport, Frame::Send(event, 2)))
+        return;
+
+    const std::string receipts[] = {"1", "2"};
+    bool message = false;
+
+    for (const std::string& receipt : receipts) {
+        read = readFrame(ioContext, *transport, buffer);
+
+        // the MESSAGE may come before or after the SEND's receipt
+        if (!read.ec && read.frame.compare(0, 8, "MESSAGE\n") == 0) {
+            message = read.frame.find("over " + address) != std::string::npos;
+            read = readFrame(ioContext, *transport, buffer);
+        }
+
+        if (read.ec || Frame::parseFrame(read.frame).getHeader("receipt-id") != receipt) {
+            fail(address, "expected receipt " + receipt + ", got "
+                 + (read.ec ? read.ec.message() : read.frame));
+            return;
+        }
+    }
+
+    if (!message) {
+        read = readFrame(ioContext, *transport, buffer);
+        message = !read.ec && read.frame.find("over " + address) != std::string::npos;
+    }
+
+    if (!message)
+        fail(address, "the report did not come back as a MESSAGE");
+
+    // a read left pending when the transport closes ends with operation_aborted
+    Read aborted = {false, boost::system::error_code(), std::string()};
+    transport->asyncReadUntil(buffer, '\0', [&aborted](const boost::system::error_code& ec, size_t) {
+        aborted.done = true;
+        aborted.ec = ec;
+    });
+
+    transport->close();
+
+    if (transport->isOpen())
+        fail(address, "still open after close()");
+
+    ioContext.restart();
+    while (!aborted.done && ioContext.run_one_for(std::chrono::seconds(1)) > 0) {
+    }
+
+    if (!aborted.done || aborted.ec != boost::asio::error::operation_aborted)
+        fail(address, "pending read not aborted by close(): " + aborted.ec.message());
+}
+
+// shutdown() ends a pending read as if the broker had hung up
+static void hangUp(const std::string& address)
+{
+    boost::asio::io_context ioContext;
+    std::shared_ptr<Transport> transport = Transport::create(ioContext, address);
+    boost::asio::streambuf buffer;
+    boost::system::error_code ec;
+
+    transport->connect(ec);
+    if (ec) {
+        fail(address, "could not connect: " + ec.message());
+        return;
+    }
+
+    Read read = {false, boost::system::error_code(), std::string()};
+    transport->asyncReadUntil(buffer, '\0', [&read](const boost::system::error_code& ec, size_t) {
+        read.done = true;
+        read.ec = ec;
+    });
+
+    transport->shutdown();
+
+    while (!read.done && ioContext.run_one_for(std::chrono::seconds(1)) > 0) {
+    }
+
+    if (!read.done || read.ec != boost::asio::error::eof)
+        fail(address, "pending read after shutdown() ended with '" + read.ec.message() + "', expected end of file");
+
+    transport->close();
+}
+
+int main()
+{
+    Log::setLevel(LogLevel::ERROR); // uring: falls back with a warning where io_uring is missing
+
+    boost::asio::io_context brokerContext;
+    StubBroker broker;
+    StubBrokerServer server(brokerContext, broker, 0);
+    StubBrokerUnixServer unixServer(brokerContext, broker, SOCKET_PATH);
+    std::thread brokerThread([&brokerContext]() { brokerContext.run(); });
+
+    std::string port = std::to_string(server.port());
+    const std::string addresses[] = {
+        "127.0.0.1:" + port,
+        "uring:127.0.0.1:" + port,
+        "unix:" + std::string(SOCKET_PATH),
+        "mem:transport-test"
+    };
+
+    for (const std::string& address : addresses) {
+        exchange(address);
+        std::cout << address << ": ok\n";
+    }
+
+    hangUp("mem:transport-test");
+
+    try {
+        boost::asio::io_context ioContext;
+        Transport::create(ioContext, "no-port");
+        fail("no-port", "accepted as an address");
+    } catch (std::invalid_argument&) {
+    }
+
+    brokerContext.stop();
+    brokerThread.join();
+
+    std::cout << (sOk ? "PASS\n" : "FAIL\n");
+    return sOk ? 0 : 1;
+}
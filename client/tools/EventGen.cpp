@@ -0,0 +1,278 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+
+// Writes a synthetic report file in the schema Event::fromJsonFile reads
+// (channel_name, events[], general_information), streamed so that tens of
+// millions of events never have to fit in memory. The same seed always
+// produces the same file.
+//
+// --order sorted      date_time grows by --step from --start
+//         shuffled    date_time is uniformly random over the same span
+//         nearly:F    sorted, except a fraction F of events are moved up to
+//                     1000 steps earlier or later
+//
+// Event keeps date_time in an int, so every date_time must stay at or below
+// 2147483647: with the default --start and --step that is about 6.87 million
+// events. Larger files need a smaller --step or an earlier --start; the
+// generator refuses rather than write timestamps that would wrap negative.
+
+struct Options
+{
+    std::string out = "-";
+    std::string channel = "police";
+    uint64_t events = 1000;
+    std::string description = "lognormal:120:0.6";
+    size_t cities = 50;
+    size_t names = 20;
+    std::string order = "sorted";
+    size_t info = 2;
+    uint64_t seed = 1;
+    int64_t start = 1735000000; // first date_time
+    int64_t step = 60;          // seconds between consecutive events
+};
+
+static const char* CITIES[] = {
+    "Liberty City", "Vice City", "San Andreas", "Raccoon City", "Los Alamos", "Springfield",
+    "Gotham", "Metropolis", "Silent Hill", "Twin Peaks", "Hill Valley", "Sunnydale"
+};
+
+static const char* NAMES[] = {
+    "Grand Theft Auto", "Vandalism", "Burglary", "Hit and Run", "Armed Robbery", "Arson",
+    "Assault", "Fraud", "Kidnapping", "Drunk Driving", "Shoplifting", "Trespassing"
+};
+
+static const char* WORDS[] = {
+    "suspect", "fled", "the", "scene", "in", "a", "black", "SUV", "towards", "Main", "Street",
+    "witness", "reported", "male", "female", "wearing", "gray", "hoodie", "and", "blue", "jeans",
+    "license", "plate", "\"STOL3N1\"", "victim", "transported", "to", "hospital", "officers",
+    "arrived", "at", "residence", "through", "back", "window", "multiple", "cars", "damaged"
+};
+
+static void usage()
+{
+    std::cerr << "Usage: StompEventGen [--out file|-] [--channel name] [--events N] [--seed S]\n"
+                 "                     [--description fixed:LEN|uniform:MIN:MAX|lognormal:MEDIAN:SIGMA]\n"
+                 "                     [--cities N] [--names N] [--info KEYS]\n"
+                 "                     [--order sorted|shuffled|nearly:FRACTION] [--start epoch] [--step seconds]\n"
+                 "date_time is a 32-bit int: start + step * events must stay at or below 2147483647\n";
+}
+
+static bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (i + 1 >= argc)
+            return false;
+
+        std::string value = argv[++i];
+
+        if (arg == "--out") options.out = value;
+        else if (arg == "--channel") options.channel = value;
+        else if (arg == "--events") options.events = std::strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "--description") options.description = value;
+        else if (arg == "--cities") options.cities = std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--names") options.names = std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--order") options.order = value;
+        else if (arg == "--info") options.info = std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--seed") options.seed = std::strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "--start") options.start = std::strtoll(value.c_str(), nullptr, 10);
+        else if (arg == "--step") options.step = std::strtoll(value.c_str(), nullptr, 10);
+        else return false;
+    }
+
+    // writeSummary needs both of the standard keys
+    return options.cities > 0 && options.names > 0 && options.info >= 2;
+}
+
+static std::vector<std::string> splitSpec(const std::string& spec)
+{
+    std::vector<std::string> parts;
+    size_t start = 0;
+
+    for (size_t colon = spec.find(':'); colon != std::string::npos; colon = spec.find(':', start)) {
+        parts.push_back(spec.substr(start, colon - start));
+        start = colon + 1;
+    }
+
+    parts.push_back(spec.substr(start));
+    return parts;
+}
+
+// picks how long each description is
+class LengthDistribution
+{
+public:
+    explicit LengthDistribution(const std::string& spec)
+        : _kind(), _a(0), _b(0)
+    {
+        std::vector<std::string> parts = splitSpec(spec);
+        _kind = parts[0];
+
+        if (_kind == "fixed" && parts.size() == 2) {
+            _a = std::atof(parts[1].c_str());
+        } else if ((_kind == "uniform" || _kind == "lognormal") && parts.size() == 3) {
+            _a = std::atof(parts[1].c_str());
+            _b = std::atof(parts[2].c_str());
+        } else {
+            throw std::invalid_argument("Invalid description length distribution '" + spec + '\'');
+        }
+    }
+
+    size_t next(std::mt19937_64& random)
+    {
+        if (_kind == "fixed")
+            return static_cast<size_t>(_a);
+
+        if (_kind == "uniform")
+            return std::uniform_int_distribution<size_t>(static_cast<size_t>(_a), static_cast<size_t>(_b))(random);
+
+        return static_cast<size_t>(std::lognormal_distribution<double>(std::log(_a), _b)(random));
+    }
+
+private:
+    std::string _kind;
+    double _a;
+    double _b;
+};
+
+// the first names come from the list; beyond it they are numbered
+static std::vector<std::string> pickNames(const char* const* list, size_t listSize, size_t count)
+{
+    std::vector<std::string> names;
+
+    for (size_t i = 0; i < count; ++i)
+        names.push_back(i < listSize ? std::string(list[i]) : std::string(list[i % listSize]) + ' ' + std::to_string(i / listSize + 1));
+
+    return names;
+}
+
+static void writeEscaped(std::ostream& out, const char* data, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        if (data[i] == '"' || data[i] == '\\') out.put('\\');
+        out.put(data[i]);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    std::mt19937_64 random(options.seed);
+    std::vector<std::string> cities = pickNames(CITIES, sizeof(CITIES) / sizeof(*CITIES), options.cities);
+    std::vector<std::string> names = pickNames(NAMES, sizeof(NAMES) / sizeof(*NAMES), options.names);
+
+    double nearlyFraction = 0;
+    std::vector<std::string> order = splitSpec(options.order);
+
+    if (order[0] == "nearly")
+        nearlyFraction = order.size() > 1 ? std::atof(order[1].c_str()) : 0.05;
+    else if (order[0] != "sorted" && order[0] != "shuffled") {
+        usage();
+        return 1;
+    }
+
+    const int64_t span = options.step * static_cast<int64_t>(std::max<uint64_t>(options.events, 1));
+    const int64_t nearlyWindow = options.step * 1000;
+    const int64_t lastDateTime = options.start + span + (nearlyFraction > 0 ? nearlyWindow : 0);
+
+    if (lastDateTime > INT32_MAX) {
+        std::cerr << "date_time would reach " << lastDateTime << ", past the 32-bit limit of " << INT32_MAX
+                  << "; lower --events, --step or --start\n";
+        return 1;
+    }
+
+    std::unique_ptr<LengthDistribution> lengths;
+
+    try {
+        lengths.reset(new LengthDistribution(options.description));
+    } catch (std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    // descriptions are cut out of one long run of words
+    std::string text;
+    while (text.size() < (1 << 20)) {
+        text += WORDS[random() % (sizeof(WORDS) / sizeof(*WORDS))];
+        text += ' ';
+    }
+
+    std::ofstream file;
+    std::vector<char> buffer(1 << 20);
+
+    if (options.out != "-") {
+        file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        file.open(options.out);
+
+        if (!file) {
+            std::cerr << "Cannot write to '" << options.out << "'\n";
+            return 1;
+        }
+    }
+
+    std::ostream& out = (options.out == "-") ? std::cout : file;
+    std::ios::sync_with_stdio(false);
+
+    out << "{\n    \"channel_name\": \"";
+    writeEscaped(out, options.channel.data(), options.channel.size());
+    out << "\",\n    \"events\": [";
+
+    for (uint64_t i = 0; i < options.events; ++i) {
+        int64_t dateTime = options.start + options.step * static_cast<int64_t>(i);
+
+        if (order[0] == "shuffled") {
+            dateTime = options.start + static_cast<int64_t>(random() % static_cast<uint64_t>(std::max<int64_t>(span, 1)));
+        } else if (nearlyFraction > 0 && std::uniform_real_distribution<double>(0, 1)(random) < nearlyFraction) {
+            dateTime += static_cast<int64_t>(random() % (2 * nearlyWindow + 1)) - nearlyWindow;
+        }
+
+        size_t length = std::min<size_t>(lengths->next(random), text.size() / 2);
+        size_t offset = random() % (text.size() - length);
+
+        const std::string& city = cities[random() % cities.size()];
+        const std::string& name = names[random() % names.size()];
+
+        out << (i ? ",\n" : "\n")
+            << "        {\n"
+            << "            \"event_name\": \"" << name << "\",\n"
+            << "            \"city\": \"" << city << "\",\n"
+            << "            \"date_time\": " << dateTime << ",\n"
+            << "            \"description\": \"";
+        writeEscaped(out, text.data() + offset, length);
+        out << "\",\n"
+            << "            \"general_information\": {\n"
+            << "                \"active\": " << ((random() & 1) ? "true" : "false") << ",\n"
+            << "                \"forces_arrival_at_scene\": " << ((random() & 1) ? "true" : "false");
+
+        for (size_t k = 3; k <= options.info; ++k)
+            out << ",\n                \"info_" << k << "\": \"value " << random() % 100 << '"';
+
+        out << "\n            }\n        }";
+    }
+
+    out << "\n    ]\n}\n";
+    out.flush();
+
+    if (!out) {
+        std::cerr << "Writing '" << options.out << "' failed\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,418 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <limits>
+#include <map>
+#include <csignal>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <boost/asio.hpp>
+
+#include "StompProtocol.h"
+#include "StubBroker.h"
+#include "Histogram.h"
+#include "Log.h"
+
+// Simulates many users publishing to and subscribed to a set of channels and
+// measures the latency from publish to delivery at every subscriber.
+// Works against the Java server (tpc or reactor mode), StompStubBroker, or a
+// stub broker started for the run: in a child process over loopback TCP with
+// 'stub', the same through io_uring with 'uring', or inside this process
+// through the memory transport with 'mem', which leaves only the protocol's
+// own costs. The CPU time and context switches of the run put a price on
+// each transport; syscalls are not counted (/proc/self/io misses socket
+// calls), so use strace -c or perf trace -s for those.
+
+using Clock = std::chrono::steady_clock;
+
+static const char* SENT_HEADER = "x-loadgen-sent";
+
+struct Options
+{
+    std::string target = "stub";
+    size_t users = 10;
+    size_t channels = 1;
+    double rate = 10;         // events per second per user
+    size_t size = 128;        // description length in bytes
+    double duration = 10;     // seconds
+    double warmup = 1;        // seconds excluded from the results
+    size_t publishers = 4;    // publishing threads
+    bool store = false;       // keep delivered events in the client's store
+};
+
+struct User
+{
+    std::string name;
+    std::string channel;
+    std::unique_ptr<StompProtocol> protocol;
+    Histogram latency; // only touched by the user's decode thread until the run ends
+    std::atomic<uint64_t> received;
+    uint64_t published; // inside the measured window
+
+    User() : name(), channel(), protocol(), latency(), received(0), published(0) {}
+};
+
+static uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// CPU time and context switches of the whole process, broker included only
+// with 'mem'
+struct Usage
+{
+    double userSeconds;
+    double systemSeconds;
+    long voluntarySwitches;
+    long involuntarySwitches;
+
+    static Usage now()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        return Usage{
+            usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6,
+            usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6,
+            usage.ru_nvcsw,
+            usage.ru_nivcsw
+        };
+    }
+
+    Usage operator-(const Usage& other) const
+    {
+        return Usage{
+            userSeconds - other.userSeconds,
+            systemSeconds - other.systemSeconds,
+            voluntarySwitches - other.voluntarySwitches,
+            involuntarySwitches - other.involuntarySwitches
+        };
+    }
+};
+
+static void usage()
+{
+    std::cerr << "Usage: StompLoadGen <address|stub|uring|mem> [--users N] [--channels M] [--rate events/s per user]\n"
+                 "                    [--size description bytes] [--duration s] [--warmup s]\n"
+                 "                    [--publishers threads] [--store]\n";
+}
+
+static bool parseOptions(int argc, char** argv, Options& options)
+{
+    if (argc < 2)
+        return false;
+
+    options.target = argv[1];
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (arg == "--store") {
+            options.store = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            return false;
+
+        const char* value = argv[++i];
+
+        if (arg == "--users") options.users = std::strtoul(value, nullptr, 10);
+        else if (arg == "--channels") options.channels = std::strtoul(value, nullptr, 10);
+        else if (arg == "--rate") options.rate = std::atof(value);
+        else if (arg == "--size") options.size = std::strtoul(value, nullptr, 10);
+        else if (arg == "--duration") options.duration = std::atof(value);
+        else if (arg == "--warmup") options.warmup = std::atof(value);
+        else if (arg == "--publishers") options.publishers = std::strtoul(value, nullptr, 10);
+        else return false;
+    }
+
+    return options.users > 0 && options.channels > 0 && options.rate > 0 && options.publishers > 0;
+}
+
+// Runs a StubBroker on an ephemeral loopback port in a child process, so
+// that its own event loop stays out of the client's usage. Returns the
+// child's pid and sets port, or returns -1.
+static pid_t startStubBroker(unsigned short& port)
+{
+    int fds[2];
+
+    if (pipe(fds) != 0)
+        return -1;
+
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        close(fds[0]);
+
+        boost::asio::io_context ioContext;
+        StubBroker broker;
+        StubBrokerServer server(ioContext, broker, 0);
+        boost::asio::signal_set signals(ioContext, SIGTERM);
+        signals.async_wait([&ioContext](const boost::system::error_code&, int) { ioContext.stop(); });
+
+        unsigned short listening = server.port();
+        bool told = write(fds[1], &listening, sizeof(listening)) == sizeof(listening);
+        close(fds[1]);
+
+        if (told)
+            ioContext.run();
+
+        _exit(0);
+    }
+
+    close(fds[1]);
+    bool told = pid > 0 && read(fds[0], &port, sizeof(port)) == sizeof(port);
+    close(fds[0]);
+
+    if (pid > 0 && !told) {
+        kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+        return -1;
+    }
+
+    return told ? pid : -1;
+}
+
+template <typename Predicate>
+static bool waitFor(Predicate predicate, double seconds)
+{
+    Clock::time_point deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+
+    while (!predicate()) {
+        if (Clock::now() > deadline)
+            return false;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return true;
+}
+
+// Publishes for every user in users[first], users[first + step]... at the
+// configured rate. Each event is stamped with the time it was scheduled for,
+// not when it went out, so a stalled publisher cannot hide queueing delay.
+static void publish(std::vector<std::unique_ptr<User>>& users, size_t first, size_t step,
+                    const Options& options, uint64_t startNs, uint64_t measureFromNs, uint64_t endNs)
+{
+    const uint64_t interval = static_cast<uint64_t>(1e9 / options.rate);
+    std::vector<uint64_t> due;
+    std::vector<Event> events;
+
+    for (size_t i = first; i < users.size(); i += step) {
+        due.push_back(startNs + interval * i / users.size());
+        events.emplace_back(
+            users[i]->channel, "Load City", "load test", static_cast<int>(std::time(nullptr)),
+            std::string(options.size, 'x'),
+            std::map<std::string, std::string>{{"active", "true"}, {"forces_arrival_at_scene", "false"}}
+        );
+    }
+
+    while (true) {
+        size_t next = std::min_element(due.begin(), due.end()) - due.begin();
+
+        if (due[next] >= endNs)
+            break;
+
+        uint64_t now = nowNs();
+        if (due[next] > now)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due[next] - now));
+
+        User& user = *users[first + next * step];
+
+        try {
+            user.protocol->report(events[next], {{SENT_HEADER, std::to_string(due[next])}});
+            if (due[next] >= measureFromNs) ++user.published;
+        } catch (std::exception& e) {
+            std::cerr << user.name << ": " << e.what() << '\n';
+        }
+
+        due[next] += interval;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    std::string address = options.target;
+    pid_t stubPid = -1;
+
+    // forked before any thread of this process starts
+    if (options.target == "stub" || options.target == "uring") {
+        unsigned short port = 0;
+        stubPid = startStubBroker(port);
+
+        if (stubPid < 0) {
+            std::cerr << "Could not start the stub broker\n";
+            return 1;
+        }
+
+        address = (options.target == "uring" ? "uring:127.0.0.1:" : "127.0.0.1:") + std::to_string(port);
+    } else if (options.target == "mem") {
+        address = "mem:loadgen";
+    }
+
+    auto stopStub = [&]() {
+        if (stubPid > 0) {
+            kill(stubPid, SIGTERM);
+            waitpid(stubPid, nullptr, 0);
+            stubPid = -1;
+        }
+    };
+
+    std::atomic<uint64_t> measureFromNs(std::numeric_limits<uint64_t>::max());
+    std::vector<std::unique_ptr<User>> users;
+
+    // the protocol logs every login and subscription; only its warnings matter here
+    Log::setLevel(LogLevel::WARN);
+
+    for (size_t i = 0; i < options.users; ++i) {
+        User* user = new User();
+        users.emplace_back(user);
+        user->name = "loadgen" + std::to_string(i);
+        user->channel = "load" + std::to_string(i % options.channels);
+        user->protocol.reset(new StompProtocol(0));
+
+        bool store = options.store;
+        user->protocol->setMessageListener([user, store, &measureFromNs](const Frame& f) {
+            const std::string& sent = f.getHeader(SENT_HEADER);
+
+            if (sent.empty())
+                return false;
+
+            uint64_t sentNs = std::stoull(sent);
+
+            if (sentNs >= measureFromNs.load(std::memory_order_relaxed)) {
+                user->latency.record(nowNs() - sentNs);
+                user->received.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            return !store;
+        });
+
+        try {
+            user->protocol->login(address, user->name, "loadgen");
+        } catch (std::exception& e) {
+            std::cerr << e.what() << '\n';
+            users.clear();
+            stopStub();
+            return 1;
+        }
+
+        bool ready = waitFor([user]() { return user->protocol->isLoggedIn(); }, 5);
+
+        if (ready) {
+            user->protocol->subscribe(user->channel);
+            ready = waitFor([user]() { return user->protocol->isSubscribed(user->channel); }, 5);
+        }
+
+        if (!ready) {
+            std::cerr << user->name << " could not log in and subscribe to " << address << '\n';
+            users.clear();
+            stopStub();
+            return 1;
+        }
+    }
+
+    size_t publishers = std::min(options.publishers, users.size());
+    uint64_t startNs = nowNs() + 10000000;
+    uint64_t measureStartNs = startNs + static_cast<uint64_t>(options.warmup * 1e9);
+    uint64_t endNs = measureStartNs + static_cast<uint64_t>(options.duration * 1e9);
+    measureFromNs.store(measureStartNs);
+
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < publishers; ++t)
+        threads.emplace_back(publish, std::ref(users), t, publishers, std::cref(options), startNs, measureStartNs, endNs);
+
+    // the measured window is what gets charged for CPU
+    std::this_thread::sleep_for(std::chrono::nanoseconds(measureStartNs - std::min(measureStartNs, nowNs())));
+    Usage usageBefore = Usage::now();
+
+    for (std::thread& t : threads)
+        t.join();
+
+    // every event is delivered to each subscriber of its channel
+    std::vector<size_t> subscribers(options.channels, 0);
+    for (size_t i = 0; i < users.size(); ++i) ++subscribers[i % options.channels];
+
+    uint64_t published = 0;
+    uint64_t expected = 0;
+
+    for (size_t i = 0; i < users.size(); ++i) {
+        published += users[i]->published;
+        expected += users[i]->published * subscribers[i % options.channels];
+    }
+
+    auto received = [&users]() {
+        uint64_t total = 0;
+        for (const auto& user : users) total += user->received.load();
+        return total;
+    };
+
+    // wait for stragglers until deliveries stop arriving
+    uint64_t last = 0;
+    waitFor([&]() {
+        uint64_t now = received();
+        bool settled = (now == last);
+        last = now;
+        return settled;
+    }, 5);
+    Usage used = Usage::now() - usageBefore;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    for (auto& user : users) {
+        try {
+            user->protocol->logout();
+        } catch (std::exception&) {
+        }
+    }
+
+    for (auto& user : users) {
+        waitFor([&user]() { return !user->protocol->isLoggedIn(); }, 2);
+        user->protocol.reset();
+    }
+
+    Histogram latency;
+    for (const auto& user : users) latency.merge(user->latency);
+
+    stopStub();
+
+    std::cout << "target: " << options.target << " (" << address << ")\n"
+              << options.users << " users on " << options.channels << " channel(s), "
+              << options.rate << " events/s per user, " << options.size << " B descriptions, "
+              << options.duration << " s measured after " << options.warmup << " s warm-up\n\n"
+              << std::fixed << std::setprecision(1)
+              << "published: " << published << " (" << published / options.duration << "/s)\n"
+              << "delivered: " << latency.count() << " of " << expected << " expected ("
+              << latency.count() / options.duration << "/s)\n\n"
+              << "publish-to-delivery latency: ";
+
+    latency.printSummary(std::cout, 1000.0, "us");
+
+    double cpuSeconds = used.userSeconds + used.systemSeconds;
+    std::streamsize precision = std::cout.precision(2);
+    std::cout << "\nprocess CPU: " << used.userSeconds << " s user, " << used.systemSeconds << " s system, "
+              << (latency.count() ? cpuSeconds * 1e6 / latency.count() : 0) << " us per delivery\n"
+              << "context switches: " << used.voluntarySwitches << " voluntary, "
+              << used.involuntarySwitches << " involuntary\n\n";
+    std::cout.precision(precision);
+    latency.printDistribution(std::cout, 1000.0, "us");
+
+    return 0;
+}
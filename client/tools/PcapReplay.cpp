@@ -0,0 +1,147 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdlib>
+
+#include "Pcap.h"
+#include "FrameReplayer.h"
+#include "StompProtocol.h"
+#include "Log.h"
+
+// Replays the broker-to-client side of every STOMP connection in a pcap
+// capture through the client's receive path, either as fast as possible or
+// at a multiple of the recorded pace, and reports throughput and what the
+// client ended up storing.
+
+static void usage()
+{
+    std::cerr << "Usage: StompPcapReplay <capture.pcap> [--speed x|max] [--repeat n] [--decoders n]\n";
+}
+
+static std::string commandOf(const std::string& rawFrame)
+{
+    size_t start = rawFrame.find_first_not_of("\r\n");
+    if (start == std::string::npos) return "(heart-beat)";
+    return rawFrame.substr(start, rawFrame.find_first_of("\n", start) - start);
+}
+
+// the recorded frames followed by n - 1 more copies of everything but the CONNECTED
+static std::vector<TimedFrame> repeated(const std::vector<TimedFrame>& frames, size_t n)
+{
+    std::vector<TimedFrame> result(frames);
+
+    if (frames.empty())
+        return result;
+
+    double span = frames.back().time - frames.front().time;
+
+    for (size_t i = 1; i < n; ++i) {
+        for (const TimedFrame& frame : frames) {
+            if (commandOf(frame.bytes) != "CONNECTED")
+                result.push_back({frame.time + span * i, frame.bytes});
+        }
+    }
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    std::string path = argv[1];
+    double speed = 0;
+    size_t repeat = 1;
+    size_t decoders = StompProtocol::defaultDecodeWorkers();
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+
+        std::string value = argv[++i];
+
+        if (arg == "--speed") speed = (value == "max") ? 0 : std::atof(value.c_str());
+        else if (arg == "--repeat") repeat = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+        else if (arg == "--decoders") decoders = std::strtoul(value.c_str(), nullptr, 10);
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    std::vector<TcpConversation> conversations;
+
+    try {
+        conversations = TcpConversation::fromPcapFile(path);
+    } catch (std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    if (conversations.empty()) {
+        std::cerr << "No TCP conversations in '" << path << "'\n";
+        return 1;
+    }
+
+    bool complete = true;
+
+    for (const TcpConversation& conversation : conversations) {
+        std::vector<TimedFrame> frames = repeated(conversation.serverFrames, repeat);
+
+        std::map<std::string, size_t> commands;
+        for (const TimedFrame& frame : frames) ++commands[commandOf(frame.bytes)];
+
+        std::string user = conversation.login();
+        if (user.empty()) user = "replay";
+
+        std::unique_ptr<StompProtocol> protocol(new StompProtocol(decoders));
+        ReplayResult result;
+
+        // the protocol logs every login and subscription; only its warnings matter here
+        Log::setLevel(LogLevel::WARN);
+
+        try {
+            result = FrameReplayer(*protocol).replay(frames, speed, user, conversation.passcode());
+        } catch (std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+
+        std::cout << conversation.server << " -> " << conversation.client << " (" << user << ")";
+        if (conversation.missingBytes > 0) std::cout << ", " << conversation.missingBytes << " bytes missing from the capture";
+        std::cout << '\n';
+
+        for (const auto& command : commands)
+            std::cout << "  " << std::left << std::setw(12) << command.first << std::right << command.second << '\n';
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << "  " << result.frames << " frames, " << result.bytes << " bytes, "
+                  << result.messages << " messages handled in " << result.seconds * 1000 << " ms";
+
+        if (result.seconds > 0)
+            std::cout << std::setprecision(0) << " (" << result.messages / result.seconds << " msg/s, "
+                      << std::setprecision(1) << result.bytes / result.seconds / 1e6 << " MB/s)";
+
+        std::cout << '\n';
+
+        for (const ChannelMemory& channel : protocol->getMemoryUsage())
+            std::cout << "  stored: " << channel.channel << ' ' << channel.events << " events\n";
+
+        if (!result.complete) {
+            std::cout << "  incomplete: timed out waiting for messages\n";
+            complete = false;
+        }
+    }
+
+    return complete ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdlib>
+
+#include "SessionRecorder.h"
+#include "FrameReplayer.h"
+#include "StompProtocol.h"
+#include "Log.h"
+
+// Plays a recording made with the client's `record` command back through
+// StompProtocol's receive path, at the recorded pace, N times faster or as
+// fast as possible, and reports throughput and what the client stored.
+
+static void usage()
+{
+    std::cerr << "Usage: StompSessionReplay <recording> [--speed x|max] [--decoders n]\n";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    std::string path = argv[1];
+    double speed = 1;
+    size_t decoders = StompProtocol::defaultDecodeWorkers();
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+
+        std::string value = argv[++i];
+
+        if (arg == "--speed") speed = (value == "max") ? 0 : std::atof(value.c_str());
+        else if (arg == "--decoders") decoders = std::strtoul(value.c_str(), nullptr, 10);
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    std::vector<TimedFrame> frames;
+    size_t sessions = 0;
+
+    try {
+        frames = SessionRecorder::load(path, &sessions);
+    } catch (std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    std::map<std::string, size_t> commands;
+
+    for (const TimedFrame& frame : frames) {
+        size_t start = frame.bytes.find_first_not_of("\r\n");
+        ++commands[start == std::string::npos ? "(heart-beat)" : frame.bytes.substr(start, frame.bytes.find('\n', start) - start)];
+    }
+
+    double recorded = frames.empty() ? 0 : frames.back().time - frames.front().time;
+
+    std::cout << path << ": " << sessions << " session(s), " << frames.size() << " frames over "
+              << std::fixed << std::setprecision(3) << recorded << " s\n";
+
+    for (const auto& command : commands)
+        std::cout << "  " << std::left << std::setw(12) << command.first << std::right << command.second << '\n';
+
+    StompProtocol protocol(decoders);
+    ReplayResult result;
+
+    // the protocol logs every login and subscription; only its warnings matter here
+    Log::setLevel(LogLevel::WARN);
+
+    try {
+        result = FrameReplayer(protocol).replay(frames, speed, "replay", "replay");
+    } catch (std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    if (speed > 0)
+        std::cout << "replayed at " << std::setprecision(1) << speed << "x: ";
+    else
+        std::cout << "replayed at max speed: ";
+
+    std::cout << result.bytes << " bytes, " << result.messages << " messages handled in "
+              << std::setprecision(3) << result.seconds * 1000 << " ms";
+
+    if (result.seconds > 0)
+        std::cout << std::setprecision(0) << " (" << result.messages / result.seconds << " msg/s, "
+                  << std::setprecision(1) << result.bytes / result.seconds / 1e6 << " MB/s)";
+
+    std::cout << '\n';
+
+    for (const ChannelMemory& channel : protocol.getMemoryUsage())
+        std::cout << "  stored: " << channel.channel << ' ' << channel.events << " events\n";
+
+    if (!result.complete) {
+        std::cout << "incomplete: timed out waiting for messages\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <string>
+#include <boost/asio.hpp>
+
+// Front end of a client started with --daemon <socket>: sends commands in
+// the client's own syntax and prints what each one printed. Only links asio,
+// so a task's command costs a process start and a local round trip, not a
+// broker handshake.
+//
+//   StompCtl <socket> <command...>   runs one command
+//   StompCtl <socket>                runs each line of stdin
+
+using boost::asio::local::stream_protocol;
+
+static const char REPLY_END = '\0'; // ControlServer::REPLY_END
+
+static bool runCommand(stream_protocol::socket& socket, boost::asio::streambuf& reply, const std::string& command)
+{
+    boost::system::error_code ec;
+    boost::asio::write(socket, boost::asio::buffer(command + '\n'), ec);
+
+    size_t length = ec ? 0 : boost::asio::read_until(socket, reply, REPLY_END, ec);
+
+    if (ec) {
+        std::cerr << "Lost the client daemon: " << ec.message() << '\n';
+        return false;
+    }
+
+    auto data = boost::asio::buffers_begin(reply.data());
+    std::cout << std::string(data, data + length - 1) << std::flush;
+    reply.consume(length);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <socket> [command...]\n";
+        return 1;
+    }
+
+    boost::asio::io_context ioContext;
+    stream_protocol::socket socket(ioContext);
+    boost::system::error_code ec;
+    socket.connect(stream_protocol::endpoint(argv[1]), ec);
+
+    if (ec) {
+        std::cerr << "No client daemon on '" << argv[1] << "': " << ec.message() << '\n';
+        return 1;
+    }
+
+    boost::asio::streambuf reply;
+
+    if (argc > 2) {
+        std::string command = argv[2];
+        for (int i = 3; i < argc; ++i)
+            command += std::string(" ") + argv[i];
+
+        return runCommand(socket, reply, command) ? 0 : 1;
+    }
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!runCommand(socket, reply, line))
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <iostream>
+#include <string>
+#include <csignal>
+#include <memory>
+#include <stdexcept>
+#include <boost/asio.hpp>
+
+#include "StubBroker.h"
+
+
+static void usage()
+{
+    std::cerr << "Usage: StompStubBroker <port|unix:path> [--heart-beat <send ms>,<receive ms>]\n";
+}
+
+int main(int argc, char** argv)
+{
+    // --heart-beat <send ms>,<receive ms> is offered to clients that ask for heart-beats
+    if (argc != 2 && !(argc == 4 && std::string(argv[2]) == "--heart-beat")) {
+        usage();
+        return 1;
+    }
+
+    boost::asio::io_context ioContext;
+    StubBroker broker;
+
+    if (argc == 4) {
+        try {
+            broker.setHeartBeat(HeartBeat::parse(argv[3]));
+        } catch (std::invalid_argument& e) {
+            std::cerr << e.what() << '\n';
+            usage();
+            return 1;
+        }
+    }
+
+    std::string listen = argv[1];
+    std::unique_ptr<StubBrokerServer> server;
+    std::unique_ptr<StubBrokerUnixServer> unixServer;
+
+    if (listen.compare(0, 5, "unix:") == 0) {
+        unixServer.reset(new StubBrokerUnixServer(ioContext, broker, listen.substr(5)));
+        std::cout << "Stub broker listening on " << listen.substr(5) << '\n';
+    } else {
+        server.reset(new StubBrokerServer(ioContext, broker, static_cast<unsigned short>(std::stoi(listen))));
+        std::cout << "Stub broker listening on port " << server->port() << '\n';
+    }
+
+    boost::asio::signal_set signals(ioContext, SIGINT, SIGTERM);
+    signals.async_wait([&ioContext](const boost::system::error_code&, int) { ioContext.stop(); });
+
+    ioContext.run();
+
+    std::cout << broker.framesReceived() << " frames received, "
+              << broker.messagesDelivered() << " messages delivered\n";
+
+    return 0;
+}